@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(CB_BENCH_HAVE_BOOST)
+#include <boost/circular_buffer.hpp>
+#endif
+
+#include "circular_buffer.h"
+
+// Shared pieces of the benchmarks: an element of a given size and the
+// few operations whose spelling differs between the compared containers.
+namespace bench {
+
+// An element of N bytes whose first 8 hold a key, so that scans have
+// something to add up.
+template <size_t N>
+struct blob {
+  static_assert(N >= sizeof(uint64_t));
+
+  blob() noexcept = default;
+  explicit blob(uint64_t k) noexcept
+    : key(k)
+  {}
+
+  uint64_t key = 0;
+  unsigned char pad[N - sizeof(uint64_t)] = {};
+};
+// Just the key: a zero-length pad is not valid C++.
+template <>
+struct blob<sizeof(uint64_t)> {
+  blob() noexcept = default;
+  explicit blob(uint64_t k) noexcept
+    : key(k)
+  {}
+
+  uint64_t key = 0;
+};
+
+inline uint64_t key_of(uint64_t x) noexcept {
+  return x;
+}
+template <size_t N>
+uint64_t key_of(blob<N> const& x) noexcept {
+  return x.key;
+}
+
+// circular_buffer has no value_type member, so take it from the elements.
+template <typename C>
+using value_t = std::remove_cvref_t<decltype(*std::declval<C&>().begin())>;
+
+template <typename T>
+T make(uint64_t k) {
+  return T(k);
+}
+
+// Unbounded push_back. boost::circular_buffer is bounded, so it doubles
+// its capacity by hand when full, like the other two do on their own.
+template <typename C, typename T>
+void grow_push_back(C& c, T const& val) {
+  c.push_back(val);
+}
+#if defined(CB_BENCH_HAVE_BOOST)
+template <typename T>
+void grow_push_back(boost::circular_buffer<T>& c, T const& val) {
+  if (c.full()) {
+    c.set_capacity(std::max<size_t>(1, 2 * c.capacity()));
+  }
+  c.push_back(val);
+}
+#endif
+
+// n elements in storage with room for slack more, rotated so that in the
+// ring buffers the front sits a third of the way in and the elements
+// wrap around the end, which is their steady state.
+template <typename C>
+C make_filled(size_t n, size_t slack = 0) {
+  using T = value_t<C>;
+  C c;
+#if defined(CB_BENCH_HAVE_BOOST)
+  if constexpr (std::is_same_v<C, boost::circular_buffer<T>>) {
+    c.set_capacity(n + slack);
+  }
+#endif
+  if constexpr (requires { c.reserve(n + slack); }) {
+    c.reserve(n + slack);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    c.push_back(make<T>(i));
+  }
+  for (size_t i = 0; n > 0 && i < slack + n / 3; ++i) {
+    c.pop_front();
+    c.push_back(make<T>(n + i));
+  }
+  return c;
+}
+
+// Pseudo-random indexes below n, the same for every run.
+inline std::vector<size_t> random_indexes(size_t n, size_t count = 4096) {
+  std::mt19937_64 rng(12345);
+  std::vector<size_t> out(count);
+  for (auto& i : out) {
+    i = rng() % n;
+  }
+  return out;
+}
+
+}  // namespace bench
@@ -0,0 +1,198 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+#include "circular_buffer.h"
+#include "mpmc_circular_buffer.h"
+#include "spsc_circular_buffer.h"
+
+// The concurrent rings against circular_buffer behind a std::mutex, the
+// way it has to be shared otherwise: SPSC throughput and round-trip
+// latency, and MPMC scaling from 1 to 32 threads.
+namespace {
+
+constexpr size_t queue_capacity = 1024;
+constexpr size_t batch = 64;
+
+// circular_buffer with a fixed capacity behind a mutex, with the
+// operations of the lock-free rings.
+struct locked_ring {
+  explicit locked_ring(size_t capacity) {
+    ring.set_fixed_capacity(capacity);
+  }
+
+  bool try_push_back(uint64_t val) {
+    std::lock_guard<std::mutex> lock(m);
+    if (ring.size() == ring.capacity()) {
+      return false;
+    }
+    ring.push_back(val);
+    return true;
+  }
+  bool try_pop_front(uint64_t& out) {
+    std::lock_guard<std::mutex> lock(m);
+    if (ring.empty()) {
+      return false;
+    }
+    out = ring.front();
+    ring.pop_front();
+    return true;
+  }
+  size_t try_push_n(uint64_t const* items, size_t n) {
+    std::lock_guard<std::mutex> lock(m);
+    size_t k = std::min(n, ring.capacity() - ring.size());
+    ring.append(items, items + k);
+    return k;
+  }
+  size_t try_pop_n(uint64_t* out, size_t n) {
+    std::lock_guard<std::mutex> lock(m);
+    size_t k = std::min(n, ring.size());
+    std::copy_n(ring.begin(), k, out);
+    ring.pop_front(k);
+    return k;
+  }
+
+  std::mutex m;
+  circular_buffer<uint64_t> ring;
+};
+
+// A failed attempt gives the other side the core, which matters when
+// there are fewer cores than threads.
+void backoff() {
+  std::this_thread::yield();
+}
+
+template <typename Q>
+void push_one(Q& q, uint64_t val) {
+  while (!q.try_push_back(val)) {
+    backoff();
+  }
+}
+template <typename Q>
+uint64_t pop_one(Q& q) {
+  uint64_t val;
+  while (!q.try_pop_front(val)) {
+    backoff();
+  }
+  return val;
+}
+
+using spsc_ring = spsc_circular_buffer<uint64_t>;
+
+constexpr uint64_t transfer_count = 1 << 16;
+
+// One producer thread hands transfer_count values to the benchmark
+// thread, one at a time.
+template <typename Q>
+void BM_spsc_throughput(benchmark::State& state) {
+  Q q(queue_capacity);
+  for (auto _ : state) {
+    std::thread producer([&] {
+      for (uint64_t i = 0; i < transfer_count; ++i) {
+        push_one(q, i);
+      }
+    });
+    uint64_t s = 0;
+    for (uint64_t i = 0; i < transfer_count; ++i) {
+      s += pop_one(q);
+    }
+    producer.join();
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetItemsProcessed(state.iterations() * transfer_count);
+}
+
+// The same with try_push_n/try_pop_n in batches.
+template <typename Q>
+void BM_spsc_batch_throughput(benchmark::State& state) {
+  Q q(queue_capacity);
+  for (auto _ : state) {
+    std::thread producer([&] {
+      uint64_t items[batch];
+      for (uint64_t sent = 0; sent < transfer_count;) {
+        size_t n = std::min<uint64_t>(batch, transfer_count - sent);
+        for (size_t i = 0; i < n; ++i) {
+          items[i] = sent + i;
+        }
+        for (size_t done = 0; done < n;) {
+          size_t k = q.try_push_n(items + done, n - done);
+          if (k == 0) {
+            backoff();
+          }
+          done += k;
+        }
+        sent += n;
+      }
+    });
+    uint64_t s = 0;
+    uint64_t out[batch];
+    for (uint64_t got = 0; got < transfer_count;) {
+      size_t k = q.try_pop_n(out, batch);
+      if (k == 0) {
+        backoff();
+      }
+      for (size_t i = 0; i < k; ++i) {
+        s += out[i];
+      }
+      got += k;
+    }
+    producer.join();
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetItemsProcessed(state.iterations() * transfer_count);
+}
+
+// Round trips through a pair of queues to an echo thread; the time per
+// item is the round-trip latency.
+template <typename Q>
+void BM_spsc_round_trip(benchmark::State& state) {
+  constexpr uint64_t round_trips = 1 << 12;
+  Q to_echo(queue_capacity);
+  Q from_echo(queue_capacity);
+  for (auto _ : state) {
+    std::thread echo([&] {
+      for (uint64_t i = 0; i < round_trips; ++i) {
+        push_one(from_echo, pop_one(to_echo));
+      }
+    });
+    for (uint64_t i = 0; i < round_trips; ++i) {
+      push_one(to_echo, i);
+      benchmark::DoNotOptimize(pop_one(from_echo));
+    }
+    echo.join();
+  }
+  state.SetItemsProcessed(state.iterations() * round_trips);
+}
+
+BENCHMARK_TEMPLATE(BM_spsc_throughput, spsc_ring)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_spsc_throughput, locked_ring)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_spsc_batch_throughput, spsc_ring)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_spsc_batch_throughput, locked_ring)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_spsc_round_trip, spsc_ring)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_spsc_round_trip, locked_ring)->UseRealTime();
+
+// Every benchmark thread pushes a value and then pops one, so the queue
+// never runs empty for a popping thread and never fills up. The queue is
+// shared by all the threads of all the runs and is empty between them.
+void BM_mpmc_push_pop(benchmark::State& state) {
+  static mpmc_circular_buffer<uint64_t> q(queue_capacity);
+  for (auto _ : state) {
+    q.push(1);
+    benchmark::DoNotOptimize(q.pop());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+void BM_mpmc_push_pop_locked(benchmark::State& state) {
+  static locked_ring q(queue_capacity);
+  for (auto _ : state) {
+    push_one(q, 1);
+    benchmark::DoNotOptimize(pop_one(q));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mpmc_push_pop)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(BM_mpmc_push_pop_locked)->ThreadRange(1, 32)->UseRealTime();
+
+}  // namespace
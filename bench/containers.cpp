@@ -0,0 +1,143 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_common.h"
+
+// The basic container operations of circular_buffer next to std::deque
+// and boost::circular_buffer, for 8, 64 and 256 byte elements.
+namespace {
+
+using bench::blob;
+
+template <typename T>
+using cb_ring = circular_buffer<T>;
+template <typename T>
+using std_deque = std::deque<T>;
+#if defined(CB_BENCH_HAVE_BOOST)
+template <typename T>
+using boost_ring = boost::circular_buffer<T>;
+#endif
+
+// A queue at a constant size: one push_back and one pop_front per
+// iteration, without allocations once warmed up.
+template <typename C>
+void BM_push_pop_steady(benchmark::State& state) {
+  using T = bench::value_t<C>;
+  C c = bench::make_filled<C>(state.range(0), 1);
+  T val = bench::make<T>(1);
+  for (auto _ : state) {
+    c.push_back(val);
+    c.pop_front();
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// push_back from empty to n elements, reallocating on the way.
+template <typename C>
+void BM_grow(benchmark::State& state) {
+  using T = bench::value_t<C>;
+  size_t n = state.range(0);
+  T val = bench::make<T>(1);
+  for (auto _ : state) {
+    C c;
+    for (size_t i = 0; i < n; ++i) {
+      bench::grow_push_back(c, val);
+    }
+    benchmark::DoNotOptimize(c);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+template <typename C>
+void BM_random_index(benchmark::State& state) {
+  size_t n = state.range(0);
+  C c = bench::make_filled<C>(n);
+  auto indexes = bench::random_indexes(n);
+  for (auto _ : state) {
+    uint64_t s = 0;
+    for (size_t i : indexes) {
+      s += bench::key_of(c[i]);
+    }
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetItemsProcessed(state.iterations() * indexes.size());
+}
+
+template <typename C>
+void BM_iterate(benchmark::State& state) {
+  using T = bench::value_t<C>;
+  size_t n = state.range(0);
+  C c = bench::make_filled<C>(n);
+  for (auto _ : state) {
+    uint64_t s = 0;
+    for (auto const& x : c) {
+      s += bench::key_of(x);
+    }
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+  state.SetBytesProcessed(state.iterations() * n * sizeof(T));
+}
+
+// One insert and one erase in the middle per iteration.
+template <typename C>
+void BM_insert_erase_middle(benchmark::State& state) {
+  using T = bench::value_t<C>;
+  size_t n = state.range(0);
+  C c = bench::make_filled<C>(n, 1);
+  T val = bench::make<T>(1);
+  for (auto _ : state) {
+    c.insert(c.begin() + n / 2, val);
+    c.erase(c.begin() + n / 2);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <typename C>
+void BM_copy(benchmark::State& state) {
+  using T = bench::value_t<C>;
+  size_t n = state.range(0);
+  C c = bench::make_filled<C>(n);
+  for (auto _ : state) {
+    C copy(c);
+    benchmark::DoNotOptimize(copy);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+  state.SetBytesProcessed(state.iterations() * n * sizeof(T));
+}
+
+void small_and_large(benchmark::internal::Benchmark* b) {
+  b->Arg(1 << 10)->Arg(1 << 16);
+}
+void queue_length(benchmark::internal::Benchmark* b) {
+  b->Arg(1 << 10);
+}
+void insert_length(benchmark::internal::Benchmark* b) {
+  b->Arg(1 << 10)->Arg(1 << 14);
+}
+
+#define CB_BENCH_SIZES(fn, C, args)                 \
+  BENCHMARK_TEMPLATE(fn, C<blob<8>>)->Apply(args);  \
+  BENCHMARK_TEMPLATE(fn, C<blob<64>>)->Apply(args); \
+  BENCHMARK_TEMPLATE(fn, C<blob<256>>)->Apply(args)
+
+#if defined(CB_BENCH_HAVE_BOOST)
+#define CB_BENCH_CONTAINERS(fn, args)  \
+  CB_BENCH_SIZES(fn, cb_ring, args);   \
+  CB_BENCH_SIZES(fn, std_deque, args); \
+  CB_BENCH_SIZES(fn, boost_ring, args)
+#else
+#define CB_BENCH_CONTAINERS(fn, args) \
+  CB_BENCH_SIZES(fn, cb_ring, args);  \
+  CB_BENCH_SIZES(fn, std_deque, args)
+#endif
+
+CB_BENCH_CONTAINERS(BM_push_pop_steady, queue_length);
+CB_BENCH_CONTAINERS(BM_grow, small_and_large);
+CB_BENCH_CONTAINERS(BM_random_index, small_and_large);
+CB_BENCH_CONTAINERS(BM_iterate, small_and_large);
+CB_BENCH_CONTAINERS(BM_insert_erase_middle, insert_length);
+CB_BENCH_CONTAINERS(BM_copy, small_and_large);
+
+}  // namespace
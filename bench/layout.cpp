@@ -0,0 +1,124 @@
+#include <benchmark/benchmark.h>
+
+#include <numeric>
+
+#include "bench_common.h"
+#include "circular_buffer_algorithm.h"
+
+// How the storage layout shows in the hot loops: masked versus modulo
+// wrap-around, in-place linearize() versus copying out, and scans over
+// the ring versus a plain vector.
+namespace {
+
+using modulo_ring = circular_buffer<uint64_t>;
+using pow2_ring = circular_buffer_pow2<uint64_t>;
+
+std::vector<uint64_t> make_vector(size_t n) {
+  std::vector<uint64_t> v(n);
+  std::iota(v.begin(), v.end(), 0);
+  return v;
+}
+
+// A capacity just under a power of two, so that the modulo ring really
+// wraps with % and the power-of-two ring with a mask.
+template <typename C>
+void BM_wrap_random_index(benchmark::State& state) {
+  size_t n = state.range(0);
+  C c = bench::make_filled<C>(n);
+  auto indexes = bench::random_indexes(n);
+  for (auto _ : state) {
+    uint64_t s = 0;
+    for (size_t i : indexes) {
+      s += c[i];
+    }
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetItemsProcessed(state.iterations() * indexes.size());
+  state.counters["capacity"] = static_cast<double>(c.capacity());
+}
+
+// An index loop rather than a range-for, so that every access wraps.
+template <typename C>
+void BM_wrap_index_scan(benchmark::State& state) {
+  size_t n = state.range(0);
+  C c = bench::make_filled<C>(n);
+  for (auto _ : state) {
+    uint64_t s = 0;
+    for (size_t i = 0; i < n; ++i) {
+      s += c[i];
+    }
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK_TEMPLATE(BM_wrap_random_index, modulo_ring)->Arg(1000)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_wrap_random_index, pow2_ring)->Arg(1000)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_wrap_index_scan, modulo_ring)->Arg(1000)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_wrap_index_scan, pow2_ring)->Arg(1000)->Arg(1000000);
+
+// Each iteration rotates the front by one, which wraps a linear buffer
+// again, and then makes the elements contiguous: in place, or by copying
+// them out into a new vector.
+void BM_linearize(benchmark::State& state) {
+  size_t n = state.range(0);
+  auto c = bench::make_filled<modulo_ring>(n);
+  for (auto _ : state) {
+    c.pop_front();
+    c.push_back(1);
+    benchmark::DoNotOptimize(c.linearize());
+  }
+  state.SetBytesProcessed(state.iterations() * n * sizeof(uint64_t));
+}
+void BM_linearize_copy_out(benchmark::State& state) {
+  size_t n = state.range(0);
+  auto c = bench::make_filled<modulo_ring>(n);
+  for (auto _ : state) {
+    c.pop_front();
+    c.push_back(1);
+    std::vector<uint64_t> out(c.begin(), c.end());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * n * sizeof(uint64_t));
+}
+BENCHMARK(BM_linearize)->Arg(1 << 12)->Arg(1 << 20);
+BENCHMARK(BM_linearize_copy_out)->Arg(1 << 12)->Arg(1 << 20);
+
+// The same sum over a wrapped ring and over a vector: range-for through
+// the iterator, and the segmented cb::accumulate.
+void BM_scan_vector(benchmark::State& state) {
+  auto v = make_vector(state.range(0));
+  for (auto _ : state) {
+    uint64_t s = 0;
+    for (uint64_t x : v) {
+      s += x;
+    }
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetBytesProcessed(state.iterations() * v.size() * sizeof(uint64_t));
+}
+void BM_scan_range_for(benchmark::State& state) {
+  size_t n = state.range(0);
+  auto c = bench::make_filled<modulo_ring>(n);
+  for (auto _ : state) {
+    uint64_t s = 0;
+    for (uint64_t x : c) {
+      s += x;
+    }
+    benchmark::DoNotOptimize(s);
+  }
+  state.SetBytesProcessed(state.iterations() * n * sizeof(uint64_t));
+}
+void BM_scan_segmented(benchmark::State& state) {
+  size_t n = state.range(0);
+  auto c = bench::make_filled<modulo_ring>(n);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cb::accumulate(c, uint64_t(0)));
+  }
+  state.SetBytesProcessed(state.iterations() * n * sizeof(uint64_t));
+}
+BENCHMARK(BM_scan_vector)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(BM_scan_range_for)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(BM_scan_segmented)->Arg(1 << 10)->Arg(1 << 20);
+
+}  // namespace
@@ -0,0 +1,127 @@
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <numeric>
+
+#include "bench_common.h"
+#include "circular_buffer_stats.h"
+
+// Window statistics over a wrapped ring: the segment kernels of
+// circular_buffer_stats.h (SIMD where the target has it) against the
+// same reduction written as a loop over the iterators, and rolling_stats
+// against a full pass per tick.
+namespace {
+
+template <typename T>
+circular_buffer<T> make_window(size_t n) {
+  circular_buffer<T> c;
+  c.set_fixed_capacity(n);
+  for (size_t i = 0; i < n + n / 3; ++i) {
+    c.push_back(static_cast<T>(i % 1000) / static_cast<T>(7));
+  }
+  return c;
+}
+
+template <typename T>
+void BM_sum_kernel(benchmark::State& state) {
+  auto c = make_window<T>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cb::sum(c));
+  }
+  state.SetBytesProcessed(state.iterations() * c.size() * sizeof(T));
+}
+template <typename T>
+void BM_sum_iterators(benchmark::State& state) {
+  auto c = make_window<T>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(std::accumulate(c.begin(), c.end(), T()));
+  }
+  state.SetBytesProcessed(state.iterations() * c.size() * sizeof(T));
+}
+
+template <typename T>
+void BM_min_kernel(benchmark::State& state) {
+  auto c = make_window<T>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cb::min_value(c));
+  }
+  state.SetBytesProcessed(state.iterations() * c.size() * sizeof(T));
+}
+template <typename T>
+void BM_min_iterators(benchmark::State& state) {
+  auto c = make_window<T>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(*std::min_element(c.begin(), c.end()));
+  }
+  state.SetBytesProcessed(state.iterations() * c.size() * sizeof(T));
+}
+
+template <typename T>
+void BM_variance_kernel(benchmark::State& state) {
+  auto c = make_window<T>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cb::variance(c));
+  }
+  state.SetBytesProcessed(state.iterations() * c.size() * sizeof(T));
+}
+template <typename T>
+void BM_variance_iterators(benchmark::State& state) {
+  auto c = make_window<T>(state.range(0));
+  for (auto _ : state) {
+    double mu = 0;
+    for (T x : c) {
+      mu += static_cast<double>(x);
+    }
+    mu /= static_cast<double>(c.size());
+    double sq = 0;
+    for (T x : c) {
+      double d = static_cast<double>(x) - mu;
+      sq += d * d;
+    }
+    benchmark::DoNotOptimize(sq / static_cast<double>(c.size()));
+  }
+  state.SetBytesProcessed(state.iterations() * c.size() * sizeof(T));
+}
+
+#define CB_BENCH_STATS(fn)                                    \
+  BENCHMARK_TEMPLATE(fn, double)->Arg(1 << 10)->Arg(1 << 16); \
+  BENCHMARK_TEMPLATE(fn, float)->Arg(1 << 10)->Arg(1 << 16);  \
+  BENCHMARK_TEMPLATE(fn, int64_t)->Arg(1 << 10)->Arg(1 << 16)
+
+CB_BENCH_STATS(BM_sum_kernel);
+CB_BENCH_STATS(BM_sum_iterators);
+CB_BENCH_STATS(BM_min_kernel);
+CB_BENCH_STATS(BM_min_iterators);
+CB_BENCH_STATS(BM_variance_kernel);
+CB_BENCH_STATS(BM_variance_iterators);
+
+// One tick: a new value enters the window and all the statistics are
+// read, maintained incrementally or recomputed with the kernels.
+void BM_rolling_stats_tick(benchmark::State& state) {
+  cb::rolling_stats<double> stats(state.range(0));
+  double x = 0;
+  for (auto _ : state) {
+    stats.push_back(std::fmod(x += 1.25, 1000.0));
+    benchmark::DoNotOptimize(stats.mean());
+    benchmark::DoNotOptimize(stats.variance());
+    benchmark::DoNotOptimize(stats.min());
+    benchmark::DoNotOptimize(stats.max());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+void BM_recompute_tick(benchmark::State& state) {
+  auto c = make_window<double>(state.range(0));
+  double x = 0;
+  for (auto _ : state) {
+    c.push_back(std::fmod(x += 1.25, 1000.0));
+    benchmark::DoNotOptimize(cb::mean(c));
+    benchmark::DoNotOptimize(cb::variance(c));
+    benchmark::DoNotOptimize(cb::min_value(c));
+    benchmark::DoNotOptimize(cb::max_value(c));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_rolling_stats_tick)->Arg(64)->Arg(1 << 12);
+BENCHMARK(BM_recompute_tick)->Arg(64)->Arg(1 << 12);
+
+}  // namespace
@@ -1,82 +1,457 @@
 #pragma once
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
 #include <utility>
 #include <algorithm>
+#include <type_traits>
 
-template <typename T>
+namespace cb::detail {
+
+// Classic iterator categories, so that move_iterator over a pointer still
+// counts as multi-pass (its C++20 iterator_concept is only input).
+template <typename It>
+concept forward_iterator = requires {
+  typename std::iterator_traits<It>::iterator_category;
+} && std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>;
+
+// Number of slots to allocate so that n elements fit.
+constexpr size_t slots_for(size_t n, bool power_of_two) noexcept {
+  if (!power_of_two) {
+    return n;
+  }
+  size_t slots = 1;
+  while (slots < n) {
+    slots <<= 1;
+  }
+  return slots;
+}
+
+}  // namespace cb::detail
+
+// Growth policies: next_capacity(n) is the element capacity to grow to from
+// n. A result that isn't larger than n is bumped to n + 1.
+namespace cb {
+
+struct grow_2x {
+  static constexpr size_t next_capacity(size_t n) noexcept {
+    return n < 2 ? 2 : 2 * n;
+  }
+};
+
+struct grow_1_5x {
+  static constexpr size_t next_capacity(size_t n) noexcept {
+    return n < 2 ? 2 : n + n / 2;
+  }
+};
+
+template <size_t K>
+struct grow_by {
+  static_assert(K > 0, "grow_by needs a non-zero increment");
+
+  static constexpr size_t next_capacity(size_t n) noexcept {
+    return n + K;
+  }
+};
+
+// Adds auto-shrink to Growth: once a pop or erase leaves fewer than
+// capacity() / Divisor elements, the storage is halved. The gap between
+// the shrink and grow thresholds keeps a size oscillating around one of
+// them from reallocating on every operation.
+template <typename Growth, size_t Divisor = 4>
+struct auto_shrink : Growth {
+  static_assert(Divisor > 2, "auto_shrink needs a divisor above 2 to leave room after halving");
+
+  static constexpr size_t shrink_divisor = Divisor;
+};
+
+// Allocates storage aligned to Alignment bytes (or alignof(T) if that is
+// larger) through aligned operator new, e.g. to keep scans of 64-byte
+// records on cache-line boundaries or to allow aligned SIMD loads.
+template <typename T, size_t Alignment = 64>
+struct aligned_allocator {
+  static_assert((Alignment & (Alignment - 1)) == 0, "alignment must be a power of two");
+
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  static constexpr size_t alignment = std::max(Alignment, alignof(T));
+
+  template <typename U>
+  struct rebind {
+    using other = aligned_allocator<U, Alignment>;
+  };
+
+  aligned_allocator() noexcept = default;
+  template <typename U>
+  aligned_allocator(aligned_allocator<U, Alignment> const&) noexcept {}
+
+  T* allocate(size_t n) {
+    if (n > size_t(-1) / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment)));
+  }
+  void deallocate(T* p, size_t n) noexcept {
+    ::operator delete(p, n * sizeof(T), std::align_val_t(alignment));
+  }
+
+  friend bool operator==(aligned_allocator const&, aligned_allocator const&) noexcept {
+    return true;
+  }
+};
+
+// Stats policies: the buffer calls on_push(n, size, capacity) after adding
+// n elements, on_pop(n) after removing n, on_reallocate(capacity, bytes)
+// after moving its bytes into new storage of capacity elements, and
+// report(buffer) when it is destroyed or asked to report. no_stats makes
+// all of these empty and takes no space. A policy with state must be
+// default constructible and copyable, for moves and swaps.
+struct no_stats {
+  void on_push(size_t, size_t, size_t) noexcept {}
+  void on_pop(size_t) noexcept {}
+  void on_reallocate(size_t, size_t) noexcept {}
+  void report(void const*) const noexcept {}
+};
+
+struct buffer_stats {
+  size_t reallocations = 0;  // growing or shrinking, inline storage included
+  size_t bytes_copied = 0;   // relocated by those reallocations
+  size_t peak_size = 0;
+  size_t peak_capacity = 0;
+  size_t pushes = 0;         // elements added, by any operation
+  size_t pops = 0;           // elements removed, by any operation
+};
+
+// Receives the counters of a counting_stats buffer, with the buffer's
+// address to tell buffers apart, e.g. to export them as metrics.
+using stats_callback = void (*)(buffer_stats const& stats, void const* buffer);
+
+namespace detail {
+inline std::atomic<stats_callback> stats_sink{nullptr};
+}
+
+// Installs the process-wide callback (nullptr for none) and returns the
+// previous one. It may be called from any thread that reports.
+inline stats_callback set_stats_callback(stats_callback f) noexcept {
+  return detail::stats_sink.exchange(f, std::memory_order_acq_rel);
+}
+
+// Counts into a buffer_stats, which stats() returns, and reports it to
+// the stats callback. The counters belong to one object and are not
+// synchronized, like the buffer itself.
+struct counting_stats : buffer_stats {
+  void on_push(size_t n, size_t size, size_t capacity) noexcept {
+    pushes += n;
+    peak_size = std::max(peak_size, size);
+    peak_capacity = std::max(peak_capacity, capacity);
+  }
+  void on_pop(size_t n) noexcept {
+    pops += n;
+  }
+  void on_reallocate(size_t capacity, size_t bytes) noexcept {
+    ++reallocations;
+    bytes_copied += bytes;
+    peak_capacity = std::max(peak_capacity, capacity);
+  }
+  // Buffers that never held or allocated anything, such as moved-from
+  // ones, have nothing to report.
+  void report(void const* buffer) const noexcept {
+    if (pushes == 0 && reallocations == 0) {
+      return;
+    }
+    if (stats_callback f = detail::stats_sink.load(std::memory_order_acquire)) {
+      f(*this, buffer);
+    }
+  }
+};
+
+}  // namespace cb
+
+namespace cb::detail {
+
+template <typename Growth>
+constexpr size_t shrink_divisor_of() noexcept {
+  if constexpr (requires { Growth::shrink_divisor; }) {
+    return Growth::shrink_divisor;
+  } else {
+    return 0;
+  }
+}
+
+// Alignment of the storage handed out by Alloc, for the inline storage
+// to match.
+template <typename T, typename Alloc>
+constexpr size_t storage_alignment() noexcept {
+  if constexpr (requires { Alloc::alignment; }) {
+    return std::max(alignof(T), size_t(Alloc::alignment));
+  } else {
+    return alignof(T);
+  }
+}
+
+// Uninitialized room for Slots elements of T inside the buffer object.
+template <typename T, size_t Slots, size_t Align>
+struct inline_storage {
+  alignas(Align) unsigned char bytes[Slots * sizeof(T)];
+
+  T* data() const noexcept {
+    return reinterpret_cast<T*>(const_cast<unsigned char*>(bytes));
+  }
+};
+// No inline storage: nothing, since a zero-length array is not valid C++.
+template <typename T, size_t Align>
+struct inline_storage<T, 0, Align> {
+  T* data() const noexcept {
+    return nullptr;
+  }
+};
+
+}  // namespace cb::detail
+
+// Storage is obtained from Alloc and elements are constructed and destroyed
+// through std::allocator_traits. Trivially copyable elements are still
+// relocated with memcpy. std::allocator already honours an over-aligned T;
+// cb::aligned_allocator (aligned_circular_buffer) picks a larger alignment.
+//
+// PowerOfTwo keeps the physical capacity a power of two, so wrap-around is a
+// mask instead of a division. reserve() then rounds up to the next power.
+//
+// InlineCapacity reserves room for that many elements inside the object;
+// the buffer only allocates once it outgrows them. Moving or swapping a
+// buffer whose elements are inline moves the elements.
+//
+// Growth picks the capacity to grow to (cb::grow_2x, cb::grow_1_5x,
+// cb::grow_by<K>), and cb::auto_shrink on top of it returns memory after
+// a burst. shrink_to_fit() does that on demand with any policy.
+//
+// Stats instruments the buffer: cb::no_stats compiles to nothing, while
+// cb::counting_stats (instrumented_circular_buffer) counts reallocations,
+// relocated bytes, peak size and capacity and pushes and pops, readable
+// through stats() and reported to cb::set_stats_callback() on destruction.
+// The counters follow the storage: moving or swapping buffers moves or
+// swaps them, and a moved-from buffer starts again from zero. A copy
+// counts its elements as pushes; copy assignment counts the replaced
+// elements as pops and the new ones as pushes.
+template <typename T, typename Alloc = std::allocator<T>, bool PowerOfTwo = false,
+          size_t InlineCapacity = 0, typename Growth = cb::grow_2x, typename Stats = cb::no_stats>
 struct circular_buffer {
   template <typename U>
   struct basic_iterator;
 
+  using allocator_type = Alloc;
+
   using iterator = basic_iterator<T>;
   using const_iterator = basic_iterator<T const>;
   using reverse_iterator = std::reverse_iterator<iterator>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
-  circular_buffer() noexcept                   //O(1)
-    : arr(nullptr)
-    , sz(0)
-    , cap(0)
-    , head(0)
+  circular_buffer() noexcept(noexcept(Alloc()))  //O(1)
+    : circular_buffer(Alloc())
   {};
 
+  explicit circular_buffer(Alloc const& a) noexcept    //O(1)
+    : head(0)
+    , sz(0)
+    , cap(inline_slots)
+    , arr(nullptr)
+    , fixed(false)
+    , alloc(a)
+  {
+    arr = local.data();
+  }
+
   circular_buffer(circular_buffer const& other)    // O(n), strong
-    : circular_buffer()
+    : circular_buffer(other, alloc_traits::select_on_container_copy_construction(other.alloc))
+  {}
+
+  circular_buffer(circular_buffer const& other, Alloc const& a) // O(n), strong
+    : circular_buffer(a)
   {
-    reserve(other.size());
-    for (auto it = other.begin(); it != other.end(); ++it) {
-      push_back(*it);
+    if (other.fixed) {
+      set_fixed_capacity(other.cap);
+    } else {
+      reserve(other.size());
+    }
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      other.memcpyToArray(arr);
+      sz = other.sz;
+      counters.on_push(sz, sz, cap);
+    } else {
+      for (auto it = other.begin(); it != other.end(); ++it) {
+        push_back(*it);
+      }
+    }
+  }
+  circular_buffer(circular_buffer&& other) noexcept(nothrow_steal) // O(1), O(n) if inline
+    : circular_buffer(other.alloc)
+  {
+    steal_storage(other);
+    counters = std::exchange(other.counters, Stats());
+  }
+
+  // Steals the storage if the allocators compare equal, otherwise moves
+  // the elements one by one into storage from a.
+  circular_buffer(circular_buffer&& other, Alloc const& a) // O(1) or O(n)
+    : circular_buffer(a)
+  {
+    if (alloc == other.alloc) {
+      steal_storage(other);
+      counters = std::exchange(other.counters, Stats());
+    } else {
+      if (other.fixed) {
+        set_fixed_capacity(other.cap);
+      } else {
+        reserve(other.size());
+      }
+      append(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
     }
   }
+
   ~circular_buffer() {                               // O(n)
+    counters.report(this);
     clear();
-    operator delete(arr);
+    release_storage();
   }
-  circular_buffer& operator=(circular_buffer other){  // O(n), strong
+  circular_buffer& operator=(circular_buffer const& other) {  // O(n), strong
     if (this == &other) {
       return *this;
     }
-    swap(other);
-    other.clear();
+    size_t replaced = sz;
+    if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+      circular_buffer copy(other, other.alloc);
+      swap_storage(copy);
+      std::swap(alloc, copy.alloc);
+      copy.counters = Stats();
+    } else {
+      circular_buffer copy(other, alloc);
+      swap_storage(copy);
+      copy.counters = Stats();
+    }
+    counters.on_pop(replaced);
+    counters.on_push(sz, sz, cap);
+    return *this;
+  }
+
+  // The moved-from buffer is left empty with no storage (or with just its
+  // inline storage).
+  circular_buffer& operator=(circular_buffer&& other) noexcept(
+      (alloc_traits::propagate_on_container_move_assignment::value ||
+       alloc_traits::is_always_equal::value) && nothrow_steal) {           // O(1), O(n) if inline
+    if (this == &other) {
+      return *this;
+    }
+    if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+      circular_buffer moved(std::move(other));
+      swap_storage(moved);
+      std::swap(alloc, moved.alloc);
+      counters = std::exchange(moved.counters, Stats());
+    } else {
+      circular_buffer moved(std::move(other), alloc);
+      swap_storage(moved);
+      counters = std::exchange(moved.counters, Stats());
+    }
     return *this;
   }
 
+  allocator_type get_allocator() const noexcept {     // O(1)
+    return alloc;
+  }
+
+  // The counters of the Stats policy, e.g. cb::buffer_stats with
+  // cb::counting_stats.
+  Stats const& stats() const noexcept {              // O(1)
+    return counters;
+  }
+  // Hands the counters to the stats callback now rather than on
+  // destruction.
+  void report_stats() const noexcept {               // O(1)
+    counters.report(this);
+  }
+
   size_t size() const noexcept {                     // O(1)
     return sz;
   }
   T& operator[](size_t index) noexcept {             // O(1)
-    return arr[(head + index) % cap];
+    return arr[get_arr_pos(index)];
   }
   T const& operator[](size_t index) const noexcept {  // O(1)
-    return const_cast<T const&>(arr[(head + index) % cap]);
+    return arr[get_arr_pos(index)];
   }
 
   bool empty() const noexcept {                     // O(1), nothrow
     return sz == 0;
   }
-  void clear() noexcept {                          // O(n), nothrow
-    for (auto it = begin(); it != end(); ++it) {
-      it->~T();
+  void clear() noexcept {                          // O(n), O(1) for trivial T, nothrow
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      destroy_logical(0, sz);
     }
+    counters.on_pop(sz);
     sz = 0;
     head = 0;
   }
 
-  void push_back(T const& val) { // O(1), strong
-    T val_copy(val);
-    ensure_cap();
-    if (empty()) {
-      new (arr) T(val_copy);
+  // Removes elements from the back or appends value-initialized elements
+  // (or copies of value) until size() is n. With a fixed capacity,
+  // requires n <= capacity().
+  void resize(size_t n) {                          // O(|n - size()|), strong
+    resize_with(n);
+  }
+  void resize(size_t n, T const& value) {          // O(|n - size()|), strong
+    if (n > cap) {  // value may be an element that the growth moves away
+      T copy(value);
+      resize_with(n, copy);
     } else {
-      new (arr + ((tail() + 1) % cap)) T(val_copy);
+      resize_with(n, value);
+    }
+  }
+
+  // A full fixed-capacity buffer drops an element to make room and then
+  // moves the new one into the freed slot, so the dropped element is lost
+  // if that move throws: strong for a noexcept move, basic otherwise.
+  void push_back(T const& val) { // O(1), strong, basic when a full fixed buffer evicts and T's move can throw
+    emplace_back(val);
+  }
+  void push_back(T&& val) { // O(1), strong, basic when a full fixed buffer evicts and T's move can throw
+    emplace_back(std::move(val));
+  }
+  template <typename... Args>
+  T& emplace_back(Args&&... args) { // O(1), strong, basic when a full fixed buffer evicts and T's move can throw
+    if (sz < cap) {
+      construct(arr + get_arr_pos(sz), std::forward<Args>(args)...);
+    } else if (!fixed) {
+      grow_emplace(false, std::forward<Args>(args)...);
+    } else {  // full fixed-capacity buffer, drop the oldest
+      T val(std::forward<Args>(args)...);
+      pop_front();
+      construct(arr + get_arr_pos(sz), std::move(val));
     }
     ++sz;
+    counters.on_push(1, sz, cap);
+    return back();
   }
-  void pop_back() noexcept { // O(1)
-    arr[tail()].~T();
+  void pop_back() noexcept { // O(1), O(n) if it auto-shrinks
+    destroy(arr + tail());
     --sz;
+    counters.on_pop(1);
+    maybe_shrink();
+  }
+  // Removes the last n elements. Requires n <= size().
+  void pop_back(size_t n) noexcept { // O(n), O(1) for trivial T
+    assert(n <= sz);
+    if (n == 0) {
+      return;
+    }
+    destroy_logical(sz - n, sz);
+    sz -= n;
+    counters.on_pop(n);
+    maybe_shrink();
   }
   T& back() noexcept {            // O(1)
     return arr[tail()];
@@ -85,19 +460,50 @@ struct circular_buffer {
     return arr[tail()];
   }
 
-  void push_front(T const& val) { // O(1), strong
-    T val_copy(val);
-    ensure_cap();
-    if (!empty()) {
-      head = (head + cap - 1) % cap;
+  // Same guarantee as push_back when a full fixed buffer drops the newest.
+  void push_front(T const& val) { // O(1), strong, basic when a full fixed buffer evicts and T's move can throw
+    emplace_front(val);
+  }
+  void push_front(T&& val) { // O(1), strong, basic when a full fixed buffer evicts and T's move can throw
+    emplace_front(std::move(val));
+  }
+  template <typename... Args>
+  T& emplace_front(Args&&... args) { // O(1), strong, basic when a full fixed buffer evicts and T's move can throw
+    if (sz < cap) {
+      size_t pos = empty() ? head : wrap(head + cap - 1);
+      construct(arr + pos, std::forward<Args>(args)...);
+      head = pos;
+    } else if (!fixed) {
+      grow_emplace(true, std::forward<Args>(args)...);
+    } else {  // full fixed-capacity buffer, drop the newest
+      T val(std::forward<Args>(args)...);
+      pop_back();
+      size_t pos = wrap(head + cap - 1);
+      construct(arr + pos, std::move(val));
+      head = pos;
     }
-    new (arr + head) T(val_copy);
     ++sz;
+    counters.on_push(1, sz, cap);
+    return front();
   }
-  void pop_front() noexcept { // O(1)
-    arr[head].~T();
-    head = (head + 1) % cap;
+  void pop_front() noexcept { // O(1), O(n) if it auto-shrinks
+    destroy(arr + head);
+    head = wrap(head + 1);
     --sz;
+    counters.on_pop(1);
+    maybe_shrink();
+  }
+  // Removes the first n elements. Requires n <= size().
+  void pop_front(size_t n) noexcept { // O(n), O(1) for trivial T
+    assert(n <= sz);
+    if (n == 0) {
+      return;
+    }
+    destroy_logical(0, n);
+    head = wrap(head + n);
+    sz -= n;
+    counters.on_pop(n);
+    maybe_shrink();
   }
   T& front() noexcept {            // O(1)
     return arr[head];
@@ -106,6 +512,191 @@ struct circular_buffer {
     return arr[head];
   }
 
+  // The range must not refer to elements of this buffer. With a fixed
+  // capacity the oldest elements are dropped first to make room, and input
+  // iterators are appended one at a time, so only the basic guarantee
+  // holds there.
+  template <typename InputIt>
+  void append(InputIt first, InputIt last) { // O(k), strong, basic when a fixed buffer evicts or for input iterators
+    if constexpr (cb::detail::forward_iterator<InputIt>) {
+      size_t n = std::distance(first, last);
+      if (n == 0) {
+        return;
+      }
+      if (fixed) {
+        if (n > cap) {
+          std::advance(first, n - cap);
+          n = cap;
+        }
+        if (sz + n > cap) {
+          pop_front(sz + n - cap);
+        }
+      } else {
+        reserve_for(n);
+      }
+      construct_range(get_arr_pos(sz), n, first, last);
+      sz += n;
+      counters.on_push(n, sz, cap);
+    } else {
+      for (; first != last; ++first) {
+        emplace_back(*first);
+      }
+    }
+  }
+  void append(std::span<T const> items) {    // O(k), strong, basic when a fixed buffer evicts
+    append(items.begin(), items.end());
+  }
+
+  // Keeps the order of the range: after the call front() is *first.
+  // With a fixed capacity the newest elements are dropped first, so only
+  // the basic guarantee holds there.
+  template <typename ForwardIt>
+    requires cb::detail::forward_iterator<ForwardIt>
+  void prepend(ForwardIt first, ForwardIt last) { // O(k), strong, basic when a fixed buffer evicts
+    size_t n = std::distance(first, last);
+    if (n == 0) {
+      return;
+    }
+    if (fixed) {
+      if (n > cap) {
+        last = std::next(first, cap);
+        n = cap;
+      }
+      if (sz + n > cap) {
+        pop_back(sz + n - cap);
+      }
+    } else {
+      reserve_for(n);
+    }
+    size_t new_head = wrap(head + cap - n);
+    construct_range(new_head, n, first, last);
+    head = new_head;
+    sz += n;
+    counters.on_push(n, sz, cap);
+  }
+  void prepend(std::span<T const> items) {         // O(k), strong, basic when a fixed buffer evicts
+    prepend(items.begin(), items.end());
+  }
+
+  // The occupied storage as at most two contiguous regions in logical
+  // order: array_one() starts at front(), array_two() holds the part that
+  // wrapped around to the start of the array and is empty otherwise.
+  std::span<T> array_one() noexcept {             // O(1)
+    return std::span<T>(arr + head, first_segment_len());
+  }
+  std::span<T const> array_one() const noexcept { // O(1)
+    return std::span<T const>(arr + head, first_segment_len());
+  }
+  std::span<T> array_two() noexcept {             // O(1)
+    return std::span<T>(arr, sz - first_segment_len());
+  }
+  std::span<T const> array_two() const noexcept { // O(1)
+    return std::span<T const>(arr, sz - first_segment_len());
+  }
+
+  // The free slots after back() as at most two contiguous regions, in the
+  // order push_back() would fill them. Trivially copyable elements can be
+  // written there in place (e.g. by readv) and then added with commit().
+  std::span<T> free_array_one() noexcept {        // O(1)
+    size_t pos = sz == cap ? head : get_arr_pos(sz);
+    return std::span<T>(arr + pos, std::min(cap - sz, cap - pos));
+  }
+  std::span<T> free_array_two() noexcept {        // O(1)
+    return std::span<T>(arr, cap - sz - free_array_one().size());
+  }
+
+  // Two-phase append: makes room for n more elements and returns the
+  // first n free slots as at most two regions. The caller writes the
+  // elements in place and then adds them with commit(n) or fewer, so they
+  // are never built elsewhere and copied in. With a fixed capacity
+  // std::length_error is thrown unless n slots are free.
+  std::pair<std::span<T>, std::span<T>> prepare(size_t n) // O(1), O(n) if it grows, strong
+    requires std::is_trivially_copyable_v<T>
+  {
+    if (fixed && n > cap - sz) {
+      throw std::length_error("circular_buffer::prepare: exceeds the fixed capacity");
+    }
+    if (!fixed) {
+      reserve_for(n);
+    }
+    auto one = free_array_one();
+    size_t first_len = std::min(n, one.size());
+    return {one.first(first_len), free_array_two().first(n - first_len)};
+  }
+
+  // The first n elements as at most two regions, to be read in place
+  // before consume(n). Requires n <= size().
+  std::pair<std::span<T>, std::span<T>> peek(size_t n) noexcept { // O(1)
+    auto one = array_one();
+    size_t first_len = std::min(n, one.size());
+    return {one.first(first_len), array_two().first(n - first_len)};
+  }
+  std::pair<std::span<T const>, std::span<T const>> peek(size_t n) const noexcept { // O(1)
+    auto one = array_one();
+    size_t first_len = std::min(n, one.size());
+    return {one.first(first_len), array_two().first(n - first_len)};
+  }
+
+  // Makes the first n free slots, already written through free_array_one()
+  // and free_array_two() (or prepare()), the last n elements. Requires n
+  // free slots.
+  void commit(size_t n) noexcept                  // O(1)
+    requires std::is_trivially_copyable_v<T>
+  {
+    assert(n <= cap - sz);
+    sz += n;
+    counters.on_push(n, sz, cap);
+  }
+
+  // Removes the first n elements, e.g. once they have been written out
+  // from array_one() and array_two(). Requires n <= size().
+  void consume(size_t n) noexcept {               // O(n), O(1) for trivial T
+    pop_front(n);
+  }
+
+  // Rotates the elements in place so that they occupy [0, size()) of the
+  // underlying array and returns a pointer to front(). No allocation.
+  // Invalidates pointers and references to elements.
+  T* linearize() noexcept(std::is_nothrow_move_constructible_v<T> &&
+                          std::is_nothrow_move_assignable_v<T>) { // O(n), basic
+    if (head == 0) {
+      return arr;
+    }
+    if (head + sz <= cap) {
+      shift_down(head, sz, 0);
+    } else {
+      // Move the front part down next to the wrapped part, then rotate
+      // the now contiguous range.
+      size_t wrapped_len = sz - first_segment_len();
+      if (wrapped_len < head) {
+        shift_down(head, first_segment_len(), wrapped_len);
+      }
+      std::rotate(arr, arr + wrapped_len, arr + sz);
+    }
+    head = 0;
+    return arr;
+  }
+
+  // Ring mode: reallocates to room for exactly n elements (rounded up to
+  // a power of two in PowerOfTwo mode) and from then on a push into a full
+  // buffer overwrites the element at the opposite end in O(1) instead of
+  // growing, so pushes never allocate. reserve() still changes the fixed
+  // capacity explicitly. Requires 0 < n and size() <= n.
+  void set_fixed_capacity(size_t n) { // O(n), strong
+    assert(n > 0 && sz <= n);
+    size_t new_slots = slots_for(n);
+    if (new_slots != cap) {
+      reallocate(new_slots);
+    }
+    fixed = true;
+  }
+  void reset_fixed_capacity() noexcept { // O(1)
+    fixed = false;
+  }
+  bool has_fixed_capacity() const noexcept { // O(1)
+    return fixed;
+  }
+
   void reserve(size_t desired_capacity) { // O(n), strong
     increase_cap(desired_capacity);
   }
@@ -113,17 +704,37 @@ struct circular_buffer {
     return cap;
   }
 
+  // Reallocates to the smallest storage that holds size() elements, or
+  // to the inline storage, and releases the heap block of an empty
+  // buffer. Does nothing with a fixed capacity.
+  void shrink_to_fit() {                  // O(n), strong
+    if (fixed) {
+      return;
+    }
+    if (sz == 0 && InlineCapacity == 0) {
+      release_storage();
+      arr = nullptr;
+      cap = 0;
+      head = 0;
+      return;
+    }
+    size_t new_slots = std::max(slots_for(sz), inline_slots);
+    if (new_slots < cap) {
+      reallocate(new_slots);
+    }
+  }
+
   iterator begin() noexcept {             // O(1)
-    return iterator(node(this, 0));
+    return make_iterator(0);
   }
   const_iterator begin() const noexcept { // O(1)
-    return const_iterator(node(this, 0));
+    return make_iterator(0);
   }
   iterator end() noexcept {
-    return iterator(node(this, sz));
+    return make_iterator(sz);
   }
   const_iterator end() const noexcept { // O(1)
-    return const_iterator(node(this, sz));
+    return make_iterator(sz);
   }
 
   reverse_iterator rbegin() noexcept { // O(1)
@@ -140,219 +751,635 @@ struct circular_buffer {
   }
 
   iterator insert(const_iterator pos, T const& val) {     // O(n), basic
-    if (pos - begin() < end() - pos) {
-      push_front(val);
-      auto cur = begin();
-      while (cur < pos) {
-        auto nxt = cur + 1;
-        std::swap(*cur, *nxt);
-        ++cur;
-      }
-      return cur;
-    } else {
-      push_back(val);
-      auto cur = end() - 1;
-      while (cur > pos) {
-        auto prv = cur - 1;
-        std::swap(*cur, *prv);
-        --cur;
+    T copy(val);
+    return insert(pos, std::move(copy));
+  }
+  iterator insert(const_iterator pos, T&& val) {          // O(n), basic
+    auto first = std::make_move_iterator(std::addressof(val));
+    return insert(pos, first, first + 1);
+  }
+
+  // Opens a gap of std::distance(first, last) elements once, shifting the
+  // shorter side, and fills it. The range must not refer to elements of
+  // this buffer. With a fixed capacity the elements must fit: nothing is
+  // dropped, and std::length_error is thrown with the buffer unchanged.
+  template <typename ForwardIt>
+    requires cb::detail::forward_iterator<ForwardIt>
+  iterator insert(const_iterator pos, ForwardIt first, ForwardIt last) { // O(n + k), basic
+    size_t index = pos.index;
+    size_t k = std::distance(first, last);
+    if (fixed && k > cap - sz) {
+      throw std::length_error("circular_buffer::insert: exceeds the fixed capacity");
+    }
+    if (k > 0) {
+      reserve_for(k);
+      if (index < sz - index) {
+        insert_front_side(index, k, first);
+      } else {
+        insert_back_side(index, k, first);
       }
-      return cur;
+      counters.on_push(k, sz, cap);
     }
+    return make_iterator(index);
   }
 
   iterator erase(const_iterator pos) {                         // O(n), basic
-    size_t index = pos.get_arr_index();
-    if (pos - begin() < end() - pos) {
-      iterator cur(node(this, index));
-      while (cur > begin()) {
-        auto prv = cur - 1;
-        std::swap(*prv, *cur);
-        --cur;
-      }
-      pop_front();
+    return erase(pos, pos + 1);
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {  // O(n), basic
+    size_t first_index = first.index;
+    size_t last_index = last.index;
+    size_t n = last_index - first_index;
+    if (n == 0) {
+      return make_iterator(first_index);
+    }
+    if (first_index < sz - last_index) {
+      move_right(0, first_index, last_index);
+      destroy_logical(0, n);
+      head = wrap(head + n);
     } else {
-      iterator cur(node(this, index));
-      while (cur < end() - 1) {
-        auto nxt = cur + 1;
-        std::swap(*nxt, *cur);
-        ++cur;
-      }
-      pop_back();
+      move_left(last_index, sz, first_index);
+      destroy_logical(sz - n, sz);
     }
-    return iterator(node(this, index));
+    sz -= n;
+    counters.on_pop(n);
+    maybe_shrink();
+    return make_iterator(first_index);
   }
 
-  iterator erase(const_iterator first, const_iterator last) {  // O(n), basic
-    size_t first_index = first.get_arr_index();
-    size_t last_index = last.get_arr_index();
-    if (first - begin() < end() - last) {
-      if (first > begin()) {
-        iterator end_1 = iterator(node(this, first_index - 1));
-        iterator end_2 = iterator(node(this, last_index - 1));
-        while (end_1 > begin()) {
-          std::swap(*end_1, *end_2);
-          --end_1, --end_2;
-        }
-      }
-      for (size_t i = 0; i < last_index - first_index; ++i) {
-        pop_front();
-      }
+  // Allocators are swapped only if they propagate on swap; otherwise
+  // they must compare equal.
+  void swap(circular_buffer& other) noexcept(nothrow_steal) { // O(1), O(n) if inline
+    if constexpr (alloc_traits::propagate_on_container_swap::value) {
+      std::swap(alloc, other.alloc);
     } else {
-      if (last != end()) {
-        iterator begin_1 = iterator(node(this, last_index));
-        iterator begin_2 = iterator(node(this, first_index));
-        while (begin_1 < end()) {
-          std::swap(*begin_1, *begin_2);
-          ++begin_1, ++begin_2;
-        }
-      }
-      for (size_t i = 0; i < last_index - first_index; ++i) {
-        pop_back();
-      }
+      assert(alloc == other.alloc);
     }
-    return iterator(node(this, first_index));
+    swap_storage(other);
+    std::swap(counters, other.counters);
   }
 
-  void swap(circular_buffer& other) noexcept {               // O(1)
+private:
+  using alloc_traits = std::allocator_traits<Alloc>;
+  static_assert(std::is_same_v<typename alloc_traits::pointer, T*>,
+                "fancy pointers are not supported");
+
+  size_t head;
+  size_t sz;
+  size_t cap;
+  T* arr;
+  bool fixed;
+  [[no_unique_address]] Alloc alloc;
+  [[no_unique_address]] Stats counters;
+
+  static constexpr size_t inline_slots =
+      InlineCapacity > 0 ? cb::detail::slots_for(InlineCapacity, PowerOfTwo) : 0;
+  static constexpr size_t shrink_divisor = cb::detail::shrink_divisor_of<Growth>();
+  static constexpr bool nothrow_steal = InlineCapacity == 0 || std::is_nothrow_move_constructible_v<T>;
+
+  [[no_unique_address]] cb::detail::inline_storage<T, inline_slots, cb::detail::storage_alignment<T, Alloc>()> local;
+
+  bool is_inline() const noexcept {
+    return InlineCapacity > 0 && arr == local.data();
+  }
+
+  void release_storage() noexcept {
+    if (!is_inline()) {
+      deallocate(arr, cap);
+    }
+  }
+
+  // Takes over the contents of other, which is left empty with its own
+  // inline storage (or none). *this must be empty and still on its inline
+  // storage (or have none), as right after construction. The counters are
+  // left to the caller.
+  void steal_storage(circular_buffer& other) noexcept(nothrow_steal) {
+    if (other.is_inline()) {
+      other.relocateToArray(arr);
+      cap = other.cap;
+      sz = other.sz;
+      other.destroy_logical(0, other.sz);
+      other.sz = 0;
+      other.head = 0;
+      other.cap = inline_slots;
+    } else {
+      arr = other.arr;
+      cap = other.cap;
+      sz = other.sz;
+      head = other.head;
+      other.arr = other.local.data();
+      other.cap = inline_slots;
+      other.sz = 0;
+      other.head = 0;
+    }
+    fixed = other.fixed;
+    other.fixed = false;
+  }
+
+  void swap_storage(circular_buffer& other) noexcept(nothrow_steal) {
+    if constexpr (InlineCapacity > 0) {
+      if (is_inline() || other.is_inline()) {
+        circular_buffer tmp(alloc);
+        tmp.steal_storage(*this);
+        steal_storage(other);
+        other.steal_storage(tmp);
+        return;
+      }
+    }
     std::swap(head, other.head);
     std::swap(sz, other.sz);
     std::swap(cap, other.cap);
     std::swap(arr, other.arr);
+    std::swap(fixed, other.fixed);
   }
 
-private:
-  int head;
-  size_t sz;
-  size_t cap;
-  T* arr;
+  template <typename... Args>
+  void construct(T* p, Args&&... args) {
+    alloc_traits::construct(alloc, p, std::forward<Args>(args)...);
+  }
 
-  int tail() const {
+  void destroy(T* p) noexcept {
+    alloc_traits::destroy(alloc, p);
+  }
+
+  T* allocate(size_t n) {
+    return alloc_traits::allocate(alloc, n);
+  }
+
+  void deallocate(T* p, size_t n) noexcept {
+    if (p != nullptr) {
+      alloc_traits::deallocate(alloc, p, n);
+    }
+  }
+
+  size_t tail() const noexcept {
     if (sz == 0) {
       return head;
     }
-    return (head + sz + cap - 1) % cap;
+    return get_arr_pos(sz - 1);
   }
 
-  struct node {
-    circular_buffer* buf;
-    size_t arr_index;
+  size_t first_segment_len() const noexcept {
+    return std::min(sz, cap - head);
+  }
 
-    node() = default;
+  size_t wrap(size_t pos) const noexcept {
+    if constexpr (PowerOfTwo) {
+      return pos & (cap - 1);
+    } else {
+      return pos % cap;
+    }
+  }
 
-    node(circular_buffer const* _buf, size_t const _arr_index)
-      : buf(const_cast<circular_buffer*>(_buf))
-      , arr_index(_arr_index)
-    {}
+  static constexpr size_t slots_for(size_t new_cap) noexcept {
+    return cb::detail::slots_for(new_cap, PowerOfTwo);
+  }
 
-    node(node const& other)
-      : buf(other.buf)
-      , arr_index(other.arr_index)
-    {}
-  };
+  // Grows at most once so that n more elements fit, keeping the
+  // geometric growth of single pushes.
+  void reserve_for(size_t n) {
+    if (sz + n > cap) {
+      increase_cap(std::max(sz + n, grown_cap()));
+    }
+  }
 
-  void copyToArray(T* dest) {
-    if (head <= tail()) {
-      for (size_t i = head; i < head + sz; ++i) {
-        try {
-          new (dest + (i - head)) T(arr[i]);
-        } catch(...) {
-          if (i > head) {
-            delete_array(dest, 0, i - head - 1);
-            operator delete(dest);
-          }
-          throw;
+  // Constructs n elements from [first, last) into the free slots starting
+  // at physical index pos, which span at most two contiguous segments.
+  template <typename ForwardIt>
+  void construct_range(size_t pos, size_t n, ForwardIt first, ForwardIt last) {
+    size_t first_len = std::min(n, cap - pos);
+    ForwardIt mid = std::next(first, first_len);
+    construct_segment(arr + pos, first, mid);
+    try {
+      construct_segment(arr, mid, last);
+    } catch (...) {
+      delete_range(arr + pos, first_len);
+      throw;
+    }
+  }
+
+  // Same as construct_range, with n elements constructed from args.
+  template <typename... Args>
+  void construct_fill(size_t pos, size_t n, Args const&... args) {
+    size_t first_len = std::min(n, cap - pos);
+    fill_segment(arr + pos, first_len, args...);
+    try {
+      fill_segment(arr, n - first_len, args...);
+    } catch (...) {
+      delete_range(arr + pos, first_len);
+      throw;
+    }
+  }
+
+  template <typename... Args>
+  void fill_segment(T* dest, size_t n, Args const&... args) {
+    size_t done = 0;
+    try {
+      for (; done < n; ++done) {
+        construct(dest + done, args...);
+      }
+    } catch (...) {
+      delete_range(dest, done);
+      throw;
+    }
+  }
+
+  template <typename... Args>
+  void resize_with(size_t n, Args const&... args) {
+    if (n <= sz) {
+      pop_back(sz - n);
+      return;
+    }
+    assert(!fixed || n <= cap);
+    reserve_for(n - sz);
+    construct_fill(get_arr_pos(sz), n - sz, args...);
+    counters.on_push(n - sz, n, cap);
+    sz = n;
+  }
+
+  template <typename ForwardIt>
+  void construct_segment(T* dest, ForwardIt first, ForwardIt last) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      std::uninitialized_copy(first, last, dest);
+    } else {
+      size_t done = 0;
+      try {
+        for (; first != last; ++first, ++done) {
+          construct(dest + done, *first);
         }
+      } catch (...) {
+        delete_range(dest, done);
+        throw;
       }
+    }
+  }
+
+  // Moves the len elements at [from, from + len) down to [to, to + len),
+  // to < from. The slots [to, from) are free on entry, and the slots left
+  // behind are free on exit.
+  void shift_down(size_t from, size_t len, size_t to) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      std::memmove(arr + to, arr + from, len * sizeof(T));
     } else {
-      int head_len = cap - head;
-      for (size_t i = head; i < cap; ++i) {
+      for (size_t i = 0; i < len; ++i) {
+        if (to + i < from) {
+          construct(arr + to + i, std::move(arr[from + i]));
+        } else {
+          arr[to + i] = std::move(arr[from + i]);
+        }
+      }
+      size_t freed = std::max(to + len, from);
+      delete_range(arr + freed, from + len - freed);
+    }
+  }
+
+  // The helpers below take logical indices relative to head and split
+  // them into contiguous physical chunks, so the element loops run over
+  // plain pointers and lower to memmove for trivially copyable T.
+
+  // F is called as f(src, dest, len) on each chunk, front to back.
+  template <typename F>
+  void for_each_chunk(size_t src, size_t dest, size_t n, F f) {
+    while (n > 0) {
+      size_t ps = get_arr_pos(src);
+      size_t pd = get_arr_pos(dest);
+      size_t len = std::min({n, cap - ps, cap - pd});
+      f(arr + ps, arr + pd, len);
+      src += len;
+      dest += len;
+      n -= len;
+    }
+  }
+
+  // Same, back to front; src_end and dest_end are one past the last index.
+  template <typename F>
+  void for_each_chunk_backward(size_t src_end, size_t dest_end, size_t n, F f) {
+    while (n > 0) {
+      size_t ps = get_arr_pos(src_end - 1) + 1;
+      size_t pd = get_arr_pos(dest_end - 1) + 1;
+      size_t len = std::min({n, ps, pd});
+      f(arr + ps - len, arr + pd - len, len);
+      src_end -= len;
+      dest_end -= len;
+      n -= len;
+    }
+  }
+
+  // Move-assigns [first, last) to dest <= first.
+  void move_left(size_t first, size_t last, size_t dest) {
+    for_each_chunk(first, dest, last - first, [](T* s, T* d, size_t len) {
+      std::move(s, s + len, d);
+    });
+  }
+
+  // Move-assigns [first, last) so that it ends at dest_end >= last.
+  void move_right(size_t first, size_t last, size_t dest_end) {
+    for_each_chunk_backward(last, dest_end, last - first, [](T* s, T* d, size_t len) {
+      std::move_backward(s, s + len, d + len);
+    });
+  }
+
+  // Move-constructs [first, last) into the free slots starting at dest.
+  // On exception the elements constructed so far are destroyed.
+  void uninit_move(size_t first, size_t last, size_t dest) {
+    size_t done = 0;
+    try {
+      for_each_chunk(first, dest, last - first, [&](T* s, T* d, size_t len) {
+        construct_segment(d, std::make_move_iterator(s), std::make_move_iterator(s + len));
+        done += len;
+      });
+    } catch (...) {
+      destroy_logical(dest, dest + done);
+      throw;
+    }
+  }
+
+  // Assigns n elements from first to [dest, dest + n).
+  template <typename ForwardIt>
+  void assign_logical(size_t dest, ForwardIt first, size_t n) {
+    for_each_chunk(dest, dest, n, [&](T*, T* d, size_t len) {
+      std::copy_n(first, len, d);
+      std::advance(first, len);
+    });
+  }
+
+  void destroy_logical(size_t first, size_t last) noexcept {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for_each_chunk(first, first, last - first, [&](T*, T* d, size_t len) {
+        delete_range(d, len);
+      });
+    }
+  }
+
+  // Shifts [index, sz) right by k over the free slots after the tail and
+  // fills the gap from first, like std::vector::insert.
+  template <typename ForwardIt>
+  void insert_back_side(size_t index, size_t k, ForwardIt first) {
+    size_t m = sz - index;
+    if (k >= m) {
+      ForwardIt mid = std::next(first, m);
+      construct_range(get_arr_pos(sz), k - m, mid, std::next(mid, k - m));
+      try {
+        uninit_move(index, sz, index + k);
+      } catch (...) {
+        destroy_logical(sz, sz + k - m);
+        throw;
+      }
+      sz += k;
+      assign_logical(index, first, m);
+    } else {
+      size_t old_sz = sz;
+      uninit_move(sz - k, sz, sz);
+      sz += k;
+      move_right(index, old_sz - k, old_sz);
+      assign_logical(index, first, k);
+    }
+  }
+
+  // Mirror of insert_back_side: moves head back by k and shifts [0, index)
+  // left over the free slots before the old head. Indices below are
+  // relative to the new head, where the old element i sits at i + k.
+  template <typename ForwardIt>
+  void insert_front_side(size_t index, size_t k, ForwardIt first) {
+    size_t old_head = head;
+    head = wrap(head + cap - k);
+    size_t m = index;
+    try {
+      if (k >= m) {
+        construct_range(get_arr_pos(m), k - m, first, std::next(first, k - m));
         try {
-          new (dest + (i - head)) T(arr[i]);
-        } catch(...) {
-          if (i > head) {
-            delete_array(dest, 0, i - head - 1);
-            operator delete(dest);
-          }
+          uninit_move(k, k + m, 0);
+        } catch (...) {
+          destroy_logical(m, k);
           throw;
         }
+      } else {
+        uninit_move(k, 2 * k, 0);
       }
-      for (size_t i = 0; i <= tail(); ++i) {
-        try {
-          new (dest + (i + head_len)) T(arr[i]);
-        } catch(...) {
-          if (i > 0) {
-            delete_array(dest, head_len, head_len + i - 1);
-            operator delete(dest);
-          }
+    } catch (...) {
+      head = old_head;
+      throw;
+    }
+    sz += k;
+    if (k >= m) {
+      assign_logical(k, std::next(first, k - m), m);
+    } else {
+      move_left(2 * k, k + m, k);
+      assign_logical(m, first, k);
+    }
+  }
+
+  void delete_range(T* array, size_t len) noexcept {
+    if (len > 0) {
+      delete_array(array, 0, len - 1);
+    }
+  }
+
+  iterator make_iterator(size_t index) const noexcept {
+    if (cap == 0) {
+      return iterator();
+    }
+    return iterator(arr + get_arr_pos(index), arr, arr + cap, index);
+  }
+
+  // Moves the elements into dest when T's move constructor is noexcept
+  // (or T can't be copied at all), copies them otherwise, so the strong
+  // guarantee holds whenever a copy is actually needed. On exception the
+  // constructed part of dest is destroyed and the old contents are intact.
+  void relocateToArray(T* dest) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      memcpyToArray(dest);
+    } else {
+      size_t done = 0;
+      try {
+        if (head + sz <= cap) {
+          relocateSegment(arr + head, sz, dest, done);
+        } else {
+          relocateSegment(arr + head, cap - head, dest, done);
+          relocateSegment(arr, tail() + 1, dest, done);
+        }
+      } catch (...) {
+        if (done > 0) {
+          delete_array(dest, 0, done - 1);
         }
+        throw;
       }
     }
   }
 
+  // Trivially copyable T: the two occupied segments are copied with
+  // at most two memcpy calls.
+  void memcpyToArray(T* dest) const noexcept
+    requires std::is_trivially_copyable_v<T>
+  {
+    auto one = array_one();
+    auto two = array_two();
+    if (!one.empty()) {
+      std::memcpy(dest, one.data(), one.size_bytes());
+    }
+    if (!two.empty()) {
+      std::memcpy(dest + one.size(), two.data(), two.size_bytes());
+    }
+  }
+
+  void relocateSegment(T* src, size_t len, T* dest, size_t& done) {
+    for (size_t i = 0; i < len; ++i) {
+      construct(dest + done, std::move_if_noexcept(src[i]));
+      ++done;
+    }
+  }
+
   void increase_cap(size_t new_cap) {
-    if (new_cap >= cap) {
-      T* new_arr = static_cast<T*>(operator new((new_cap + 1) * sizeof(T)));
-      size_t old_sz = sz;
-      copyToArray(new_arr);
-      clear();
-      if (arr != nullptr) {
-        operator delete(arr);
+    size_t new_slots = slots_for(new_cap);
+    if (new_slots > cap) {
+      reallocate(new_slots);
+    }
+  }
+
+  void reallocate(size_t new_slots) {
+    if constexpr (InlineCapacity > 0) {
+      if (new_slots <= inline_slots) {
+        if (!is_inline()) {
+          relocateToArray(local.data());
+          replace_array(local.data(), new_slots);
+        } else {
+          linearize();
+          cap = new_slots;
+        }
+        return;
       }
-      cap = new_cap + 1;
-      sz = old_sz;
-      arr = new_arr;
     }
+    T* new_arr = allocate(new_slots);
+    try {
+      relocateToArray(new_arr);
+    } catch (...) {
+      deallocate(new_arr, new_slots);
+      throw;
+    }
+    replace_array(new_arr, new_slots);
   }
 
-  void ensure_cap() {
-    if (sz + 1 >= cap) {
-      if (cap == 0) {
-        increase_cap(2);
-      } else {
-        increase_cap(2 * (cap - 1) + 1);
+  // The new element is constructed in the new block before the old
+  // contents are relocated, so its arguments may refer to elements of
+  // this buffer and a throwing constructor leaves the buffer untouched.
+  // Does not bump sz; the caller does.
+  template <typename... Args>
+  void grow_emplace(bool at_front, Args&&... args) {
+    size_t new_slots = slots_for(grown_cap());
+    T* new_arr = allocate(new_slots);
+    size_t pos = at_front ? new_slots - 1 : sz;
+    try {
+      construct(new_arr + pos, std::forward<Args>(args)...);
+    } catch (...) {
+      deallocate(new_arr, new_slots);
+      throw;
+    }
+    try {
+      relocateToArray(new_arr);
+    } catch (...) {
+      destroy(new_arr + pos);
+      deallocate(new_arr, new_slots);
+      throw;
+    }
+    replace_array(new_arr, new_slots);
+    if (at_front) {
+      head = pos;
+    }
+  }
+
+  // Destroys the old contents and takes over new_arr, which already holds
+  // the relocated elements starting at index 0.
+  void replace_array(T* new_arr, size_t new_slots) noexcept {
+    destroy_logical(0, sz);
+    release_storage();
+    cap = new_slots;
+    head = 0;
+    arr = new_arr;
+    counters.on_reallocate(cap, sz * sizeof(T));
+  }
+
+  // Element capacity after one growth step.
+  size_t grown_cap() const noexcept {
+    return std::max(cap + 1, Growth::next_capacity(cap));
+  }
+
+  // Halves the storage once fewer than 1 / shrink_divisor of it is used.
+  // Shrinking is best effort: if the reallocation throws, the buffer is
+  // left as it was.
+  void maybe_shrink() noexcept {
+    if constexpr (shrink_divisor > 0) {
+      if (!fixed && !is_inline() && sz < cap / shrink_divisor) {
+        try {
+          reallocate(std::max(slots_for(cap / 2), inline_slots));
+        } catch (...) {
+        }
       }
     }
   }
 
-  void delete_array(T* array, size_t l, size_t r) {
-    for (size_t i = r + 1; i >= l + 1; --i) {
-      array[i - 1].~T();
+  void delete_array(T* array, size_t l, size_t r) noexcept {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (size_t i = r + 1; i >= l + 1; --i) {
+        destroy(array + i - 1);
+      }
     }
   }
 
-  int get_arr_pos(size_t index) {
-    return (head + index) % cap;
+  size_t get_arr_pos(size_t index) const noexcept {
+    return wrap(head + index);
   }
 };
 
 template <typename T>
+using circular_buffer_pow2 = circular_buffer<T, std::allocator<T>, true>;
+
+template <typename T, size_t N, typename Alloc = std::allocator<T>>
+using small_circular_buffer = circular_buffer<T, Alloc, false, N>;
+
+template <typename T, size_t Alignment = 64>
+using aligned_circular_buffer = circular_buffer<T, cb::aligned_allocator<T, Alignment>>;
+
+template <typename T>
+using instrumented_circular_buffer =
+    circular_buffer<T, std::allocator<T>, false, 0, cb::grow_2x, cb::counting_stats>;
+
+template <typename T, typename Alloc, bool PowerOfTwo, size_t InlineCapacity, typename Growth,
+          typename Stats>
 template <typename U>
-struct circular_buffer<T>::basic_iterator
+struct circular_buffer<T, Alloc, PowerOfTwo, InlineCapacity, Growth, Stats>::basic_iterator
 {
   using iterator_category = std::random_access_iterator_tag;
-  using value_type = U;
+  using value_type = std::remove_const_t<U>;
   using difference_type = ptrdiff_t;
   using pointer = U*;
   using reference = U&;
 
   basic_iterator() = default;
   basic_iterator(basic_iterator const&) = default;
+  basic_iterator& operator=(basic_iterator const&) = default;
 
   template <typename V, typename = std::enable_if_t<std::is_const_v<U> && !std::is_const_v<V>>>
   basic_iterator(basic_iterator<V> const& other)
-    : nd(other.nd)
+    : ptr(other.ptr)
+    , first(other.first)
+    , last(other.last)
+    , index(other.index)
   {}
 
   U& operator*() const {
-    return nd.buf->arr[nd.buf->get_arr_pos(nd.arr_index)];
+    return *ptr;
   }
   U* operator->() const {
-    return &nd.buf->arr[nd.buf->get_arr_pos(nd.arr_index)];
+    return ptr;
   }
 
   basic_iterator& operator++() & {
-    return *this += 1;
+    if (++ptr == last) {
+      ptr = first;
+    }
+    ++index;
+    return *this;
   }
   basic_iterator operator++(int) &{
     basic_iterator copy(*this);
@@ -361,7 +1388,12 @@ struct circular_buffer<T>::basic_iterator
   }
 
   basic_iterator& operator--() & {
-    return *this -= 1;
+    if (ptr == first) {
+      ptr = last;
+    }
+    --ptr;
+    --index;
+    return *this;
   }
   basic_iterator operator--(int) & {
     basic_iterator copy(*this);
@@ -370,7 +1402,7 @@ struct circular_buffer<T>::basic_iterator
   }
 
   friend bool operator==(basic_iterator const& a, basic_iterator const& b) {
-    return a.nd.buf == b.nd.buf && a.nd.arr_index == b.nd.arr_index;
+    return a.index == b.index;
   }
 
   friend bool operator!=(basic_iterator const& a, basic_iterator const& b) {
@@ -378,33 +1410,41 @@ struct circular_buffer<T>::basic_iterator
   }
 
   friend bool operator<(basic_iterator const& a, basic_iterator const& b) {
-    return a.nd.buf == b.nd.buf && a.nd.arr_index < b.nd.arr_index;
+    return a.index < b.index;
   }
 
   friend bool operator>(basic_iterator const& a, basic_iterator const& b) {
-    return a.nd.buf == b.nd.buf && a.nd.arr_index > b.nd.arr_index;
+    return a.index > b.index;
   }
 
   friend bool operator<=(basic_iterator const& a, basic_iterator const& b) {
-    return a.nd.buf == b.nd.buf && a.nd.arr_index <= b.nd.arr_index;
+    return a.index <= b.index;
   }
 
   friend bool operator>=(basic_iterator const& a, basic_iterator const& b) {
-    return a.nd.buf == b.nd.buf && a.nd.arr_index >= b.nd.arr_index;
+    return a.index >= b.index;
   }
 
-  reference operator[](size_t index) {  // O(1)
-    return nd.buf->arr[nd.buf->get_arr_pos(nd.arr_index + index)];
+  reference operator[](difference_type n) const {  // O(1)
+    return *(*this + n);
   }
 
+  // |k| is at most the capacity for any valid result, so one compare
+  // handles the wrap.
   basic_iterator& operator+=(difference_type k) {
-    nd.arr_index += k;
+    difference_type pos = (ptr - first) + k;
+    if (pos >= last - first) {
+      pos -= last - first;
+    } else if (pos < 0) {
+      pos += last - first;
+    }
+    ptr = first + pos;
+    index += k;
     return *this;
   }
 
   basic_iterator& operator-=(difference_type k) {
-    nd.arr_index -= k;
-    return *this;
+    return *this += -k;
   }
 
   friend basic_iterator operator+(basic_iterator it, difference_type k) {
@@ -423,19 +1463,26 @@ struct circular_buffer<T>::basic_iterator
   }
 
   friend difference_type operator-(basic_iterator const& a, basic_iterator const& b) {
-    return a.nd.arr_index - b.nd.arr_index;
+    return static_cast<difference_type>(a.index - b.index);
   }
 
 private:
-  explicit basic_iterator(node const& _nd)
-    : nd(_nd)
+  // The element pointer plus the bounds of the storage, so stepping is a
+  // pointer increment and a wrap check, and the logical index, which
+  // orders iterators and tells end() of a full buffer from begin().
+  basic_iterator(U* _ptr, U* _first, U* _last, size_t _index)
+    : ptr(_ptr)
+    , first(_first)
+    , last(_last)
+    , index(_index)
   {}
 
-  node nd;
+  U* ptr = nullptr;
+  U* first = nullptr;
+  U* last = nullptr;
+  size_t index = 0;
 
-  size_t get_arr_index() {
-    return nd.arr_index;
-  }
-
-  friend struct circular_buffer<T>;
-};
\ No newline at end of file
+  template <typename V>
+  friend struct basic_iterator;
+  friend struct circular_buffer<T, Alloc, PowerOfTwo, InlineCapacity, Growth, Stats>;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <span>
+#include <utility>
+
+#include "circular_buffer.h"
+
+// Algorithms over a ring buffer run as plain loops over its (at most two)
+// contiguous segments, so the compiler sees arrays it can vectorize. They
+// accept anything with array_one()/array_two(): circular_buffer and
+// static_circular_buffer.
+namespace cb {
+
+// Calls f(std::span) on each non-empty segment in logical order.
+template <typename Buffer, typename F>
+void for_each_segment(Buffer&& buf, F f) {          // O(1) calls
+  auto one = buf.array_one();
+  auto two = buf.array_two();
+  if (!one.empty()) {
+    f(one);
+  }
+  if (!two.empty()) {
+    f(two);
+  }
+}
+
+template <typename Buffer, typename F>
+F for_each(Buffer&& buf, F f) {                     // O(n)
+  for_each_segment(buf, [&](auto seg) {
+    for (auto& x : seg) {
+      f(x);
+    }
+  });
+  return f;
+}
+
+// Copies the elements in logical order, e.g. into a linear array.
+template <typename Buffer, typename OutputIt>
+OutputIt copy(Buffer const& buf, OutputIt out) {    // O(n)
+  for_each_segment(buf, [&](auto seg) {
+    out = std::copy(seg.begin(), seg.end(), out);
+  });
+  return out;
+}
+
+// Returns the iterator to the first element equal to val, or end().
+template <typename Buffer, typename V>
+auto find(Buffer&& buf, V const& val) {             // O(n)
+  auto one = buf.array_one();
+  auto it = std::find(one.begin(), one.end(), val);
+  if (it != one.end()) {
+    return buf.begin() + (it - one.begin());
+  }
+  auto two = buf.array_two();
+  it = std::find(two.begin(), two.end(), val);
+  return buf.begin() + (one.size() + (it - two.begin()));
+}
+
+template <typename Buffer, typename R, typename BinaryOp = std::plus<>>
+R accumulate(Buffer const& buf, R init, BinaryOp op = {}) { // O(n)
+  for_each_segment(buf, [&](auto seg) {
+    init = std::accumulate(seg.begin(), seg.end(), std::move(init), op);
+  });
+  return init;
+}
+
+// Unordered reduction: each segment is reduced separately, so reduce must
+// be associative and commutative, as for std::transform_reduce.
+template <typename Buffer, typename R, typename ReduceOp, typename TransformOp>
+R transform_reduce(Buffer const& buf, R init, ReduceOp reduce, TransformOp transform) { // O(n)
+  for_each_segment(buf, [&](auto seg) {
+    init = std::transform_reduce(seg.begin(), seg.end(), std::move(init), reduce, transform);
+  });
+  return init;
+}
+
+// Compares two buffers element by element, splitting both into chunks
+// that are contiguous on each side.
+template <typename BufferA, typename BufferB, typename Pred = std::equal_to<>>
+bool equal(BufferA const& a, BufferB const& b, Pred pred = {}) { // O(n)
+  if (a.size() != b.size()) {
+    return false;
+  }
+  auto a_one = a.array_one(), a_two = a.array_two();
+  auto b_one = b.array_one(), b_two = b.array_two();
+  decltype(a_one) a_seg[] = {a_one, a_two};
+  decltype(b_one) b_seg[] = {b_one, b_two};
+  size_t i = 0, j = 0, ai = 0, bj = 0;
+  while (i < 2 && j < 2) {
+    if (ai == a_seg[i].size()) {
+      ++i, ai = 0;
+      continue;
+    }
+    if (bj == b_seg[j].size()) {
+      ++j, bj = 0;
+      continue;
+    }
+    size_t len = std::min(a_seg[i].size() - ai, b_seg[j].size() - bj);
+    if (!std::equal(a_seg[i].begin() + ai, a_seg[i].begin() + ai + len, b_seg[j].begin() + bj, pred)) {
+      return false;
+    }
+    ai += len;
+    bj += len;
+  }
+  return true;
+}
+
+// Compares a buffer with a contiguous range.
+template <typename Buffer, typename V, size_t Extent, typename Pred = std::equal_to<>>
+bool equal(Buffer const& buf, std::span<V, Extent> range, Pred pred = {}) { // O(n)
+  if (buf.size() != range.size()) {
+    return false;
+  }
+  auto one = buf.array_one();
+  auto two = buf.array_two();
+  return std::equal(one.begin(), one.end(), range.begin(), pred) &&
+         std::equal(two.begin(), two.end(), range.begin() + one.size(), pred);
+}
+
+}  // namespace cb
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <span>
+#include <type_traits>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "circular_buffer.h"
+
+#if __has_include(<liburing.h>)
+#include <liburing.h>
+#define CB_HAVE_IO_URING 1
+#endif
+
+// Socket and file I/O straight into and out of a byte ring such as
+// circular_buffer<char>: the free space and the occupied space are each
+// at most two contiguous regions, so one readv or writev moves them without
+// a bounce buffer. Results and errors follow read(2)/write(2): the byte
+// count, or -1 with errno set (EAGAIN on a non-blocking descriptor is not
+// an error of the buffer).
+namespace cb {
+
+namespace detail {
+
+template <typename Buffer>
+using io_value_t = std::remove_reference_t<decltype(*std::declval<Buffer&>().free_array_one().data())>;
+
+// Describes up to max bytes of the two regions; returns the iovec count.
+template <typename U>
+int to_iovecs(iovec (&iov)[2], std::span<U> one, std::span<U> two, size_t max) noexcept {
+  int count = 0;
+  size_t first_len = std::min(one.size(), max);
+  size_t second_len = std::min(two.size(), max - first_len);
+  if (first_len > 0) {
+    iov[count++] = iovec{const_cast<std::remove_const_t<U>*>(one.data()), first_len};
+  }
+  if (second_len > 0) {
+    iov[count++] = iovec{const_cast<std::remove_const_t<U>*>(two.data()), second_len};
+  }
+  return count;
+}
+
+// Makes room for max more bytes unless the capacity is fixed, in which
+// case only the free space is used.
+template <typename Buffer>
+void reserve_io(Buffer& buf, size_t max) {
+  if (buf.capacity() - buf.size() < max && !buf.has_fixed_capacity()) {
+    buf.reserve(buf.size() + max);
+  }
+}
+
+}  // namespace detail
+
+// Reads up to max bytes from fd into the free space with a single readv
+// and appends them. Returns 0 at end of file or if there is no room.
+template <typename Buffer>
+ssize_t read_from(Buffer& buf, int fd, size_t max) {        // O(max)
+  static_assert(sizeof(detail::io_value_t<Buffer>) == 1, "read_from needs a byte buffer");
+  detail::reserve_io(buf, max);
+  iovec iov[2];
+  int count = detail::to_iovecs(iov, buf.free_array_one(), buf.free_array_two(), max);
+  if (count == 0) {
+    return 0;
+  }
+  ssize_t n = ::readv(fd, iov, count);
+  if (n > 0) {
+    buf.commit(static_cast<size_t>(n));
+  }
+  return n;
+}
+
+// Writes up to max bytes from the front with a single writev and
+// consumes what was written.
+template <typename Buffer>
+ssize_t write_to(Buffer& buf, int fd, size_t max = SIZE_MAX) { // O(max)
+  static_assert(sizeof(detail::io_value_t<Buffer>) == 1, "write_to needs a byte buffer");
+  iovec iov[2];
+  int count = detail::to_iovecs(iov, buf.array_one(), buf.array_two(), max);
+  if (count == 0) {
+    return 0;
+  }
+  ssize_t n = ::writev(fd, iov, count);
+  if (n > 0) {
+    buf.consume(static_cast<size_t>(n));
+  }
+  return n;
+}
+
+#if defined(CB_HAVE_IO_URING)
+
+// The same transfers as io_uring requests. prep_read/prep_write fill an
+// SQE over the buffer's regions, and complete_read/complete_write apply
+// the CQE result. The iovecs live in this object, which must outlive the
+// request, and the buffer must not be reallocated (read) or consumed
+// (write) while a request is in flight. One request of each kind at a
+// time.
+template <typename Buffer>
+struct uring_io {
+  explicit uring_io(Buffer& _buf) noexcept
+    : buf(_buf)
+  {}
+
+  void prep_read(io_uring_sqe* sqe, int fd, size_t max) {
+    detail::reserve_io(buf, max);
+    int count = detail::to_iovecs(read_iov, buf.free_array_one(), buf.free_array_two(), max);
+    io_uring_prep_readv(sqe, fd, read_iov, static_cast<unsigned>(count), static_cast<__u64>(-1));
+  }
+  void complete_read(int res) noexcept {
+    if (res > 0) {
+      buf.commit(static_cast<size_t>(res));
+    }
+  }
+
+  void prep_write(io_uring_sqe* sqe, int fd, size_t max = SIZE_MAX) noexcept {
+    int count = detail::to_iovecs(write_iov, buf.array_one(), buf.array_two(), max);
+    io_uring_prep_writev(sqe, fd, write_iov, static_cast<unsigned>(count), static_cast<__u64>(-1));
+  }
+  void complete_write(int res) noexcept {
+    if (res > 0) {
+      buf.consume(static_cast<size_t>(res));
+    }
+  }
+
+private:
+  Buffer& buf;
+  iovec read_iov[2];
+  iovec write_iov[2];
+};
+
+#endif
+
+}  // namespace cb
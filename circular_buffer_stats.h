@@ -0,0 +1,628 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "circular_buffer.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CB_STATS_AVX2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CB_STATS_NEON 1
+#endif
+
+// Window statistics over numeric ring buffers.
+//
+// cb::sum, cb::min_value, cb::max_value, cb::mean and cb::variance reduce
+// the (at most two) contiguous segments of any buffer with array_one() and
+// array_two(). double, float and int64_t use AVX2 or NEON kernels when the
+// target has them; other types, and targets without them, use scalar loops.
+//
+// cb::rolling_stats keeps a fixed-size window and updates its sum, mean and
+// variance in O(1) per push, and min/max in amortized O(1).
+namespace cb {
+
+namespace detail {
+
+template <typename Buffer>
+using stats_value_t = std::remove_const_t<typename decltype(std::declval<Buffer const&>().array_one())::element_type>;
+
+// Scalar kernels; four independent accumulators so that the adds don't
+// form one dependency chain.
+
+template <typename T>
+T sum_kernel(T const* p, size_t n) noexcept {
+  T a0{}, a1{}, a2{}, a3{};
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    a0 += p[i];
+    a1 += p[i + 1];
+    a2 += p[i + 2];
+    a3 += p[i + 3];
+  }
+  for (; i < n; ++i) {
+    a0 += p[i];
+  }
+  return (a0 + a1) + (a2 + a3);
+}
+
+// n > 0.
+template <typename T>
+T min_kernel(T const* p, size_t n) noexcept {
+  return *std::min_element(p, p + n);
+}
+
+// n > 0.
+template <typename T>
+T max_kernel(T const* p, size_t n) noexcept {
+  return *std::max_element(p, p + n);
+}
+
+// Sum of squared deviations from mean.
+template <typename T>
+double sq_dev_kernel(T const* p, size_t n, double mean) noexcept {
+  double a0 = 0, a1 = 0;
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    double d0 = static_cast<double>(p[i]) - mean;
+    double d1 = static_cast<double>(p[i + 1]) - mean;
+    a0 += d0 * d0;
+    a1 += d1 * d1;
+  }
+  if (i < n) {
+    double d = static_cast<double>(p[i]) - mean;
+    a0 += d * d;
+  }
+  return a0 + a1;
+}
+
+#if defined(CB_STATS_AVX2)
+
+inline double hsum(__m256d v) noexcept {
+  __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+inline float hsum(__m256 v) noexcept {
+  __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  return _mm_cvtss_f32(_mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1)));
+}
+
+inline double sum_kernel(double const* p, size_t n) noexcept {
+  __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    a0 = _mm256_add_pd(a0, _mm256_loadu_pd(p + i));
+    a1 = _mm256_add_pd(a1, _mm256_loadu_pd(p + i + 4));
+  }
+  double s = hsum(_mm256_add_pd(a0, a1));
+  for (; i < n; ++i) {
+    s += p[i];
+  }
+  return s;
+}
+
+inline float sum_kernel(float const* p, size_t n) noexcept {
+  __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    a0 = _mm256_add_ps(a0, _mm256_loadu_ps(p + i));
+    a1 = _mm256_add_ps(a1, _mm256_loadu_ps(p + i + 8));
+  }
+  float s = hsum(_mm256_add_ps(a0, a1));
+  for (; i < n; ++i) {
+    s += p[i];
+  }
+  return s;
+}
+
+inline int64_t sum_kernel(int64_t const* p, size_t n) noexcept {
+  __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    a0 = _mm256_add_epi64(a0, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i)));
+    a1 = _mm256_add_epi64(a1, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i + 4)));
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(a0, a1));
+  int64_t s = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < n; ++i) {
+    s += p[i];
+  }
+  return s;
+}
+
+inline double min_kernel(double const* p, size_t n) noexcept {
+  if (n < 4) {
+    return *std::min_element(p, p + n);
+  }
+  __m256d m = _mm256_loadu_pd(p);
+  size_t i = 4;
+  for (; i + 4 <= n; i += 4) {
+    m = _mm256_min_pd(m, _mm256_loadu_pd(p + i));
+  }
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, m);
+  double r = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+  for (; i < n; ++i) {
+    r = std::min(r, p[i]);
+  }
+  return r;
+}
+
+inline double max_kernel(double const* p, size_t n) noexcept {
+  if (n < 4) {
+    return *std::max_element(p, p + n);
+  }
+  __m256d m = _mm256_loadu_pd(p);
+  size_t i = 4;
+  for (; i + 4 <= n; i += 4) {
+    m = _mm256_max_pd(m, _mm256_loadu_pd(p + i));
+  }
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, m);
+  double r = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+  for (; i < n; ++i) {
+    r = std::max(r, p[i]);
+  }
+  return r;
+}
+
+inline float min_kernel(float const* p, size_t n) noexcept {
+  if (n < 8) {
+    return *std::min_element(p, p + n);
+  }
+  __m256 m = _mm256_loadu_ps(p);
+  size_t i = 8;
+  for (; i + 8 <= n; i += 8) {
+    m = _mm256_min_ps(m, _mm256_loadu_ps(p + i));
+  }
+  alignas(32) float lanes[8];
+  _mm256_store_ps(lanes, m);
+  float r = *std::min_element(lanes, lanes + 8);
+  for (; i < n; ++i) {
+    r = std::min(r, p[i]);
+  }
+  return r;
+}
+
+inline float max_kernel(float const* p, size_t n) noexcept {
+  if (n < 8) {
+    return *std::max_element(p, p + n);
+  }
+  __m256 m = _mm256_loadu_ps(p);
+  size_t i = 8;
+  for (; i + 8 <= n; i += 8) {
+    m = _mm256_max_ps(m, _mm256_loadu_ps(p + i));
+  }
+  alignas(32) float lanes[8];
+  _mm256_store_ps(lanes, m);
+  float r = *std::max_element(lanes, lanes + 8);
+  for (; i < n; ++i) {
+    r = std::max(r, p[i]);
+  }
+  return r;
+}
+
+// AVX2 has no 64-bit integer min/max; compare and blend instead.
+inline int64_t min_kernel(int64_t const* p, size_t n) noexcept {
+  if (n < 4) {
+    return *std::min_element(p, p + n);
+  }
+  __m256i m = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+  size_t i = 4;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+    m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64(m, v));
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), m);
+  int64_t r = *std::min_element(lanes, lanes + 4);
+  for (; i < n; ++i) {
+    r = std::min(r, p[i]);
+  }
+  return r;
+}
+
+inline int64_t max_kernel(int64_t const* p, size_t n) noexcept {
+  if (n < 4) {
+    return *std::max_element(p, p + n);
+  }
+  __m256i m = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+  size_t i = 4;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p + i));
+    m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64(v, m));
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), m);
+  int64_t r = *std::max_element(lanes, lanes + 4);
+  for (; i < n; ++i) {
+    r = std::max(r, p[i]);
+  }
+  return r;
+}
+
+inline double sq_dev_kernel(double const* p, size_t n, double mean) noexcept {
+  __m256d mu = _mm256_set1_pd(mean);
+  __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(p + i), mu);
+    __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(p + i + 4), mu);
+    a0 = _mm256_add_pd(a0, _mm256_mul_pd(d0, d0));
+    a1 = _mm256_add_pd(a1, _mm256_mul_pd(d1, d1));
+  }
+  double s = hsum(_mm256_add_pd(a0, a1));
+  for (; i < n; ++i) {
+    double d = p[i] - mean;
+    s += d * d;
+  }
+  return s;
+}
+
+// Deviations are taken in double to match the scalar kernel.
+inline double sq_dev_kernel(float const* p, size_t n, double mean) noexcept {
+  __m256d mu = _mm256_set1_pd(mean);
+  __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256d d0 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(p + i)), mu);
+    __m256d d1 = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(p + i + 4)), mu);
+    a0 = _mm256_add_pd(a0, _mm256_mul_pd(d0, d0));
+    a1 = _mm256_add_pd(a1, _mm256_mul_pd(d1, d1));
+  }
+  double s = hsum(_mm256_add_pd(a0, a1));
+  for (; i < n; ++i) {
+    double d = static_cast<double>(p[i]) - mean;
+    s += d * d;
+  }
+  return s;
+}
+
+#elif defined(CB_STATS_NEON)
+
+inline double sum_kernel(double const* p, size_t n) noexcept {
+  float64x2_t a0 = vdupq_n_f64(0), a1 = vdupq_n_f64(0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    a0 = vaddq_f64(a0, vld1q_f64(p + i));
+    a1 = vaddq_f64(a1, vld1q_f64(p + i + 2));
+  }
+  double s = vaddvq_f64(vaddq_f64(a0, a1));
+  for (; i < n; ++i) {
+    s += p[i];
+  }
+  return s;
+}
+
+inline float sum_kernel(float const* p, size_t n) noexcept {
+  float32x4_t a0 = vdupq_n_f32(0), a1 = vdupq_n_f32(0);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    a0 = vaddq_f32(a0, vld1q_f32(p + i));
+    a1 = vaddq_f32(a1, vld1q_f32(p + i + 4));
+  }
+  float s = vaddvq_f32(vaddq_f32(a0, a1));
+  for (; i < n; ++i) {
+    s += p[i];
+  }
+  return s;
+}
+
+inline int64_t sum_kernel(int64_t const* p, size_t n) noexcept {
+  int64x2_t a0 = vdupq_n_s64(0), a1 = vdupq_n_s64(0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    a0 = vaddq_s64(a0, vld1q_s64(p + i));
+    a1 = vaddq_s64(a1, vld1q_s64(p + i + 2));
+  }
+  int64_t s = vaddvq_s64(vaddq_s64(a0, a1));
+  for (; i < n; ++i) {
+    s += p[i];
+  }
+  return s;
+}
+
+inline double min_kernel(double const* p, size_t n) noexcept {
+  if (n < 2) {
+    return p[0];
+  }
+  float64x2_t m = vld1q_f64(p);
+  size_t i = 2;
+  for (; i + 2 <= n; i += 2) {
+    m = vminq_f64(m, vld1q_f64(p + i));
+  }
+  double r = vminvq_f64(m);
+  for (; i < n; ++i) {
+    r = std::min(r, p[i]);
+  }
+  return r;
+}
+
+inline double max_kernel(double const* p, size_t n) noexcept {
+  if (n < 2) {
+    return p[0];
+  }
+  float64x2_t m = vld1q_f64(p);
+  size_t i = 2;
+  for (; i + 2 <= n; i += 2) {
+    m = vmaxq_f64(m, vld1q_f64(p + i));
+  }
+  double r = vmaxvq_f64(m);
+  for (; i < n; ++i) {
+    r = std::max(r, p[i]);
+  }
+  return r;
+}
+
+inline float min_kernel(float const* p, size_t n) noexcept {
+  if (n < 4) {
+    return *std::min_element(p, p + n);
+  }
+  float32x4_t m = vld1q_f32(p);
+  size_t i = 4;
+  for (; i + 4 <= n; i += 4) {
+    m = vminq_f32(m, vld1q_f32(p + i));
+  }
+  float r = vminvq_f32(m);
+  for (; i < n; ++i) {
+    r = std::min(r, p[i]);
+  }
+  return r;
+}
+
+inline float max_kernel(float const* p, size_t n) noexcept {
+  if (n < 4) {
+    return *std::max_element(p, p + n);
+  }
+  float32x4_t m = vld1q_f32(p);
+  size_t i = 4;
+  for (; i + 4 <= n; i += 4) {
+    m = vmaxq_f32(m, vld1q_f32(p + i));
+  }
+  float r = vmaxvq_f32(m);
+  for (; i < n; ++i) {
+    r = std::max(r, p[i]);
+  }
+  return r;
+}
+
+// NEON has no 64-bit integer min/max; compare and select instead.
+inline int64_t min_kernel(int64_t const* p, size_t n) noexcept {
+  if (n < 2) {
+    return p[0];
+  }
+  int64x2_t m = vld1q_s64(p);
+  size_t i = 2;
+  for (; i + 2 <= n; i += 2) {
+    int64x2_t v = vld1q_s64(p + i);
+    m = vbslq_s64(vcgtq_s64(m, v), v, m);
+  }
+  int64_t r = std::min(vgetq_lane_s64(m, 0), vgetq_lane_s64(m, 1));
+  for (; i < n; ++i) {
+    r = std::min(r, p[i]);
+  }
+  return r;
+}
+
+inline int64_t max_kernel(int64_t const* p, size_t n) noexcept {
+  if (n < 2) {
+    return p[0];
+  }
+  int64x2_t m = vld1q_s64(p);
+  size_t i = 2;
+  for (; i + 2 <= n; i += 2) {
+    int64x2_t v = vld1q_s64(p + i);
+    m = vbslq_s64(vcgtq_s64(v, m), v, m);
+  }
+  int64_t r = std::max(vgetq_lane_s64(m, 0), vgetq_lane_s64(m, 1));
+  for (; i < n; ++i) {
+    r = std::max(r, p[i]);
+  }
+  return r;
+}
+
+inline double sq_dev_kernel(double const* p, size_t n, double mean) noexcept {
+  float64x2_t mu = vdupq_n_f64(mean);
+  float64x2_t a0 = vdupq_n_f64(0), a1 = vdupq_n_f64(0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float64x2_t d0 = vsubq_f64(vld1q_f64(p + i), mu);
+    float64x2_t d1 = vsubq_f64(vld1q_f64(p + i + 2), mu);
+    a0 = vfmaq_f64(a0, d0, d0);
+    a1 = vfmaq_f64(a1, d1, d1);
+  }
+  double s = vaddvq_f64(vaddq_f64(a0, a1));
+  for (; i < n; ++i) {
+    double d = p[i] - mean;
+    s += d * d;
+  }
+  return s;
+}
+
+inline double sq_dev_kernel(float const* p, size_t n, double mean) noexcept {
+  float64x2_t mu = vdupq_n_f64(mean);
+  float64x2_t a0 = vdupq_n_f64(0), a1 = vdupq_n_f64(0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t v = vld1q_f32(p + i);
+    float64x2_t d0 = vsubq_f64(vcvt_f64_f32(vget_low_f32(v)), mu);
+    float64x2_t d1 = vsubq_f64(vcvt_high_f64_f32(v), mu);
+    a0 = vfmaq_f64(a0, d0, d0);
+    a1 = vfmaq_f64(a1, d1, d1);
+  }
+  double s = vaddvq_f64(vaddq_f64(a0, a1));
+  for (; i < n; ++i) {
+    double d = static_cast<double>(p[i]) - mean;
+    s += d * d;
+  }
+  return s;
+}
+
+#endif
+
+}  // namespace detail
+
+template <typename Buffer>
+auto sum(Buffer const& buf) noexcept {                      // O(n)
+  using T = detail::stats_value_t<Buffer>;
+  auto one = buf.array_one();
+  auto two = buf.array_two();
+  return static_cast<T>(detail::sum_kernel(one.data(), one.size()) +
+                        detail::sum_kernel(two.data(), two.size()));
+}
+
+// Requires a non-empty buffer.
+template <typename Buffer>
+auto min_value(Buffer const& buf) noexcept {                // O(n)
+  auto one = buf.array_one();
+  auto two = buf.array_two();
+  auto r = detail::min_kernel(one.data(), one.size());
+  return two.empty() ? r : std::min(r, detail::min_kernel(two.data(), two.size()));
+}
+
+// Requires a non-empty buffer.
+template <typename Buffer>
+auto max_value(Buffer const& buf) noexcept {                // O(n)
+  auto one = buf.array_one();
+  auto two = buf.array_two();
+  auto r = detail::max_kernel(one.data(), one.size());
+  return two.empty() ? r : std::max(r, detail::max_kernel(two.data(), two.size()));
+}
+
+// Requires a non-empty buffer.
+template <typename Buffer>
+double mean(Buffer const& buf) noexcept {                   // O(n)
+  return static_cast<double>(sum(buf)) / static_cast<double>(buf.size());
+}
+
+// Population variance, computed in two passes for accuracy. Requires a
+// non-empty buffer.
+template <typename Buffer>
+double variance(Buffer const& buf) noexcept {               // O(n)
+  double mu = mean(buf);
+  auto one = buf.array_one();
+  auto two = buf.array_two();
+  return (detail::sq_dev_kernel(one.data(), one.size(), mu) +
+          detail::sq_dev_kernel(two.data(), two.size(), mu)) / static_cast<double>(buf.size());
+}
+
+// The last window() values pushed, with their statistics maintained as
+// values enter and leave: sum exactly (in T), mean and variance with the
+// Welford update, and min/max with monotonic queues, so that a tick costs
+// O(1) instead of a pass over the window.
+template <typename T>
+struct rolling_stats {
+  explicit rolling_stats(size_t window)       // O(window)
+    : limit(window)
+    , total()
+    , avg(0)
+    , m2(0)
+    , seq(0)
+  {
+    assert(window > 0);
+    values.set_fixed_capacity(window);
+    min_queue.reserve(window);
+    max_queue.reserve(window);
+  }
+
+  // Evicts the oldest value when the window is full.
+  void push_back(T x) {                       // O(1) amortized
+    if (values.size() == limit) {
+      pop_front();
+    }
+    values.push_back(x);
+    total += x;
+    size_t n = values.size();
+    double delta = static_cast<double>(x) - avg;
+    avg += delta / static_cast<double>(n);
+    m2 += delta * (static_cast<double>(x) - avg);
+    push_monotonic(min_queue, x, [](T a, T b) { return a <= b; });
+    push_monotonic(max_queue, x, [](T a, T b) { return a >= b; });
+    ++seq;
+  }
+
+  void pop_front() noexcept {                 // O(1)
+    T x = values.front();
+    size_t oldest = seq - values.size();
+    values.pop_front();
+    total -= x;
+    size_t n = values.size();
+    if (n == 0) {
+      avg = 0;
+      m2 = 0;
+    } else {
+      double old_avg = avg;
+      avg = (old_avg * static_cast<double>(n + 1) - static_cast<double>(x)) / static_cast<double>(n);
+      m2 = std::max(0.0, m2 - (static_cast<double>(x) - old_avg) * (static_cast<double>(x) - avg));
+    }
+    if (min_queue.front().first == oldest) {
+      min_queue.pop_front();
+    }
+    if (max_queue.front().first == oldest) {
+      max_queue.pop_front();
+    }
+  }
+
+  size_t window() const noexcept {            // O(1)
+    return limit;
+  }
+  size_t size() const noexcept {              // O(1)
+    return values.size();
+  }
+  bool empty() const noexcept {               // O(1)
+    return values.empty();
+  }
+  circular_buffer<T> const& buffer() const noexcept { // O(1)
+    return values;
+  }
+
+  T sum() const noexcept {                    // O(1)
+    return total;
+  }
+  double mean() const noexcept {              // O(1)
+    return avg;
+  }
+  double variance() const noexcept {          // O(1), population
+    return values.empty() ? 0 : m2 / static_cast<double>(values.size());
+  }
+  // Require a non-empty window.
+  T min() const noexcept {                    // O(1)
+    return min_queue.front().second;
+  }
+  T max() const noexcept {                    // O(1)
+    return max_queue.front().second;
+  }
+
+private:
+  // (sequence number, value) of the values that can still become the
+  // window minimum (or maximum), oldest first.
+  using monotonic_queue = circular_buffer<std::pair<size_t, T>>;
+
+  template <typename Dominates>
+  void push_monotonic(monotonic_queue& q, T x, Dominates dominates) {
+    while (!q.empty() && dominates(x, q.back().second)) {
+      q.pop_back();
+    }
+    q.emplace_back(seq, x);
+  }
+
+  circular_buffer<T> values;
+  monotonic_queue min_queue;
+  monotonic_queue max_queue;
+  size_t limit;
+  T total;
+  double avg;
+  double m2;
+  size_t seq;
+};
+
+}  // namespace cb
@@ -0,0 +1,314 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <numeric>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Circular buffer of trivially copyable elements whose storage is mapped
+// twice back to back in virtual memory, so [head, head + capacity()) is
+// always one contiguous range: operator[] and iterators never wrap, and
+// data() is a single pointer to all the elements, in order. This is the
+// layout for byte streams (magic_circular_buffer<char>) feeding parsers
+// that want one contiguous window.
+//
+// The capacity is rounded up to whole pages (and a whole number of
+// elements), since the mapping works on pages. Grows like circular_buffer;
+// growing remaps and copies the elements once.
+template <typename T>
+struct magic_circular_buffer {
+  static_assert(std::is_trivially_copyable_v<T>, "magic_circular_buffer needs a trivially copyable T");
+
+  using iterator = T*;
+  using const_iterator = T const*;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  magic_circular_buffer() noexcept              // O(1)
+    : head(0)
+    , sz(0)
+    , cap(0)
+    , arr(nullptr)
+  {}
+
+  explicit magic_circular_buffer(size_t capacity) // O(1)
+    : magic_circular_buffer()
+  {
+    reserve(capacity);
+  }
+
+  magic_circular_buffer(magic_circular_buffer const& other) // O(n), strong
+    : magic_circular_buffer()
+  {
+    if (other.sz > 0) {
+      reserve(other.sz);
+      std::memcpy(arr, other.data(), other.sz * sizeof(T));
+      sz = other.sz;
+    }
+  }
+
+  magic_circular_buffer(magic_circular_buffer&& other) noexcept // O(1)
+    : head(std::exchange(other.head, 0))
+    , sz(std::exchange(other.sz, 0))
+    , cap(std::exchange(other.cap, 0))
+    , arr(std::exchange(other.arr, nullptr))
+  {}
+
+  ~magic_circular_buffer() {                   // O(1)
+    unmap(arr, cap);
+  }
+
+  magic_circular_buffer& operator=(magic_circular_buffer const& other) { // O(n), strong
+    if (this != &other) {
+      magic_circular_buffer copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+  magic_circular_buffer& operator=(magic_circular_buffer&& other) noexcept { // O(1)
+    magic_circular_buffer moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  size_t size() const noexcept {               // O(1)
+    return sz;
+  }
+  size_t capacity() const noexcept {           // O(1)
+    return cap;
+  }
+  bool empty() const noexcept {                // O(1)
+    return sz == 0;
+  }
+  void clear() noexcept {                      // O(1)
+    sz = 0;
+    head = 0;
+  }
+
+  T& operator[](size_t index) noexcept {             // O(1)
+    return arr[head + index];
+  }
+  T const& operator[](size_t index) const noexcept { // O(1)
+    return arr[head + index];
+  }
+
+  // All the elements, contiguous and in order; any window
+  // [data() + i, data() + j) is contiguous as well.
+  T* data() noexcept {                         // O(1)
+    return arr + head;
+  }
+  T const* data() const noexcept {             // O(1)
+    return arr + head;
+  }
+
+  void push_back(T const& val) {               // O(1), strong
+    emplace_back(val);
+  }
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {            // O(1), strong
+    T val(std::forward<Args>(args)...);
+    if (sz == cap) {
+      reserve(grown_cap());
+    }
+    T* p = new (arr + head + sz) T(val);
+    ++sz;
+    return *p;
+  }
+  void pop_back() noexcept {                   // O(1)
+    --sz;
+  }
+  T& back() noexcept {                         // O(1)
+    return arr[head + sz - 1];
+  }
+  T const& back() const noexcept {             // O(1)
+    return arr[head + sz - 1];
+  }
+
+  void push_front(T const& val) {              // O(1), strong
+    emplace_front(val);
+  }
+  template <typename... Args>
+  T& emplace_front(Args&&... args) {           // O(1), strong
+    T val(std::forward<Args>(args)...);
+    if (sz == cap) {
+      reserve(grown_cap());
+    }
+    head = head == 0 ? cap - 1 : head - 1;
+    ++sz;
+    return *new (arr + head) T(val);
+  }
+  void pop_front() noexcept {                  // O(1)
+    head = head + 1 == cap ? 0 : head + 1;
+    --sz;
+  }
+  T& front() noexcept {                        // O(1)
+    return arr[head];
+  }
+  T const& front() const noexcept {            // O(1)
+    return arr[head];
+  }
+
+  // One memcpy, whatever the head position.
+  void append(std::span<T const> items) {      // O(k), strong
+    if (items.empty()) {
+      return;
+    }
+    if (sz + items.size() > cap) {
+      reserve(std::max(sz + items.size(), grown_cap()));
+    }
+    std::memcpy(arr + head + sz, items.data(), items.size_bytes());
+    sz += items.size();
+  }
+
+  // Same as circular_buffer::array_one/array_two, except that
+  // array_two() is always empty, so the segment algorithms run one loop.
+  std::span<T> array_one() noexcept {             // O(1)
+    return std::span<T>(data(), sz);
+  }
+  std::span<T const> array_one() const noexcept { // O(1)
+    return std::span<T const>(data(), sz);
+  }
+  std::span<T> array_two() noexcept {             // O(1)
+    return std::span<T>();
+  }
+  std::span<T const> array_two() const noexcept { // O(1)
+    return std::span<T const>();
+  }
+
+  // Rounded up to whole pages.
+  void reserve(size_t desired_capacity) {      // O(n), strong
+    if (desired_capacity <= cap) {
+      return;
+    }
+    size_t new_cap = round_up(desired_capacity);
+    T* new_arr = map_twice(new_cap);
+    if (sz > 0) {
+      std::memcpy(new_arr, data(), sz * sizeof(T));
+    }
+    unmap(arr, cap);
+    arr = new_arr;
+    cap = new_cap;
+    head = 0;
+  }
+
+  iterator begin() noexcept {                  // O(1)
+    return data();
+  }
+  const_iterator begin() const noexcept {      // O(1)
+    return data();
+  }
+  iterator end() noexcept {                    // O(1)
+    return data() + sz;
+  }
+  const_iterator end() const noexcept {        // O(1)
+    return data() + sz;
+  }
+
+  reverse_iterator rbegin() noexcept {               // O(1)
+    return reverse_iterator(end());
+  }
+  const_reverse_iterator rbegin() const noexcept {   // O(1)
+    return const_reverse_iterator(end());
+  }
+  reverse_iterator rend() noexcept {                 // O(1)
+    return reverse_iterator(begin());
+  }
+  const_reverse_iterator rend() const noexcept {     // O(1)
+    return const_reverse_iterator(begin());
+  }
+
+  void swap(magic_circular_buffer& other) noexcept { // O(1)
+    std::swap(head, other.head);
+    std::swap(sz, other.sz);
+    std::swap(cap, other.cap);
+    std::swap(arr, other.arr);
+  }
+
+private:
+  size_t head;
+  size_t sz;
+  size_t cap;
+  T* arr;
+
+  size_t grown_cap() const noexcept {
+    return cap == 0 ? 1 : 2 * cap;
+  }
+
+  // Smallest element count >= n whose size is a whole number of pages.
+  static size_t round_up(size_t n) {
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t unit = std::lcm(page, sizeof(T));
+    size_t bytes = (n * sizeof(T) + unit - 1) / unit * unit;
+    return bytes / sizeof(T);
+  }
+
+  // Reserves 2 * n elements of address space and maps the same n-element
+  // shared memory object into both halves.
+  static T* map_twice(size_t n) {
+    size_t bytes = n * sizeof(T);
+    int fd = open_anonymous();
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) < 0) {
+      fail(fd, "ftruncate");
+    }
+    void* base = ::mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      fail(fd, "mmap");
+    }
+    auto* lo = static_cast<unsigned char*>(base);
+    if (::mmap(lo, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        ::mmap(lo + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      int err = errno;
+      ::munmap(base, 2 * bytes);
+      errno = err;
+      fail(fd, "mmap");
+    }
+    ::close(fd);
+    return static_cast<T*>(base);
+  }
+
+  static void unmap(T* p, size_t n) noexcept {
+    if (p != nullptr) {
+      ::munmap(p, 2 * n * sizeof(T));
+    }
+  }
+
+  // A shared memory object with no name, which goes away once unmapped.
+  static int open_anonymous() {
+#if defined(__linux__)
+    char const* what = "memfd_create";
+    int fd = ::memfd_create("magic_circular_buffer", MFD_CLOEXEC);
+#else
+    char const* what = "shm_open";
+    char name[64];
+    int fd = -1;
+    for (int attempt = 0; attempt < 16 && fd < 0; ++attempt) {
+      std::snprintf(name, sizeof(name), "/magic_circular_buffer.%ld.%d", static_cast<long>(::getpid()), std::rand());
+      fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    if (fd >= 0) {
+      ::shm_unlink(name);
+    }
+#endif
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+    return fd;
+  }
+
+  [[noreturn]] static void fail(int fd, char const* what) {
+    int err = errno;
+    ::close(fd);
+    throw std::system_error(err, std::generic_category(), what);
+  }
+};
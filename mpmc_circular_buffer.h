@@ -0,0 +1,266 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "circular_buffer.h"
+
+// Bounded lock-free ring for any number of producer and consumer threads
+// (Vyukov's bounded MPMC queue). The slots form a power-of-two array like
+// circular_buffer_pow2; each slot carries a sequence number that says
+// whether it is free for the producer at a given position or holds the
+// element for the consumer at that position, so producers and consumers
+// only contend on their own position counter and the slot they claimed.
+//
+// try_push, try_emplace and try_pop never block. push, emplace and pop
+// spin for a while and then park the thread until the other side makes
+// progress. size() and empty() are approximate.
+template <typename T>
+struct mpmc_circular_buffer {
+  // A claimed slot must be published, so moving an element in or out of
+  // it must not throw.
+  static_assert(std::is_nothrow_move_constructible_v<T>,
+                "mpmc_circular_buffer needs a nothrow move constructor");
+
+  static constexpr size_t cache_line = 64;
+
+  // The capacity is rounded up to a power of two, and to at least 2.
+  explicit mpmc_circular_buffer(size_t capacity) // O(n)
+    : mask(cb::detail::slots_for(std::max<size_t>(capacity, 2), true) - 1)
+    , cells(static_cast<cell*>(operator new((mask + 1) * sizeof(cell), std::align_val_t(alignof(cell)))))
+    , enqueue_pos(0)
+    , sleeping_consumers(0)
+    , push_epoch(0)
+    , dequeue_pos(0)
+    , sleeping_producers(0)
+    , pop_epoch(0)
+  {
+    for (size_t i = 0; i <= mask; ++i) {
+      new (cells + i) cell(i);
+    }
+  }
+
+  mpmc_circular_buffer(mpmc_circular_buffer const&) = delete;
+  mpmc_circular_buffer& operator=(mpmc_circular_buffer const&) = delete;
+
+  // No other thread may use the buffer any more.
+  ~mpmc_circular_buffer() {                      // O(n)
+    size_t r = dequeue_pos.load(std::memory_order_relaxed);
+    size_t w = enqueue_pos.load(std::memory_order_relaxed);
+    for (; r != w; ++r) {
+      cells[r & mask].get()->~T();
+    }
+    std::destroy_n(cells, mask + 1);
+    operator delete(cells, std::align_val_t(alignof(cell)));
+  }
+
+  size_t capacity() const noexcept {             // O(1)
+    return mask + 1;
+  }
+  size_t size() const noexcept {                 // O(1), approximate
+    size_t r = dequeue_pos.load(std::memory_order_acquire);
+    size_t w = enqueue_pos.load(std::memory_order_acquire);
+    return w > r ? w - r : 0;
+  }
+  bool empty() const noexcept {                  // O(1), approximate
+    return size() == 0;
+  }
+
+  // The element is constructed before a slot is claimed, so a throwing
+  // constructor leaves the buffer untouched.
+  template <typename... Args>
+  bool try_emplace(Args&&... args) {             // O(1), strong, lock-free
+    if constexpr (std::is_nothrow_constructible_v<T, Args...>) {
+      return try_claim_push([&](T* slot) {
+        new (slot) T(std::forward<Args>(args)...);
+      });
+    } else {
+      T val(std::forward<Args>(args)...);
+      return try_claim_push([&](T* slot) {
+        new (slot) T(std::move(val));
+      });
+    }
+  }
+  bool try_push(T const& val) {                  // O(1), strong, lock-free
+    return try_emplace(val);
+  }
+  bool try_push(T&& val) {                       // O(1), strong, lock-free
+    return try_emplace(std::move(val));
+  }
+
+  bool try_pop(T& out) {                         // O(1), lock-free
+    std::optional<T> val;
+    if (!try_claim_pop(val)) {
+      return false;
+    }
+    out = std::move(*val);
+    return true;
+  }
+
+  // Block while the buffer is full.
+  template <typename... Args>
+  void emplace(Args&&... args) {
+    T val(std::forward<Args>(args)...);
+    wait_for(sleeping_producers, pop_epoch, [&] {
+      return try_claim_push([&](T* slot) {
+        new (slot) T(std::move(val));
+      });
+    });
+  }
+  void push(T const& val) {
+    emplace(val);
+  }
+  void push(T&& val) {
+    emplace(std::move(val));
+  }
+
+  // Blocks while the buffer is empty.
+  void pop(T& out) {
+    std::optional<T> val;
+    wait_for(sleeping_consumers, push_epoch, [&] {
+      return try_claim_pop(val);
+    });
+    out = std::move(*val);
+  }
+  T pop() {
+    std::optional<T> val;
+    wait_for(sleeping_consumers, push_epoch, [&] {
+      return try_claim_pop(val);
+    });
+    return std::move(*val);
+  }
+
+private:
+  // seq == pos: free for the producer at pos.
+  // seq == pos + 1: holds the element for the consumer at pos.
+  struct cell {
+    explicit cell(size_t pos) noexcept
+      : seq(pos)
+    {}
+
+    T* get() noexcept {
+      return reinterpret_cast<T*>(storage);
+    }
+
+    std::atomic<size_t> seq;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  static constexpr int spin_limit = 64;
+
+  template <typename Construct>
+  bool try_claim_push(Construct construct) noexcept {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    cell* c;
+    for (;;) {
+      c = cells + (pos & mask);
+      size_t seq = c->seq.load(std::memory_order_acquire);
+      auto dif = static_cast<std::ptrdiff_t>(seq - pos);
+      if (dif == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        return false;  // full
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    construct(c->get());
+    c->seq.store(pos + 1, std::memory_order_release);
+    wake(sleeping_consumers, push_epoch);
+    return true;
+  }
+
+  bool try_claim_pop(std::optional<T>& out) noexcept {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    cell* c;
+    for (;;) {
+      c = cells + (pos & mask);
+      size_t seq = c->seq.load(std::memory_order_acquire);
+      auto dif = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (dif == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (dif < 0) {
+        return false;  // empty
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    T* p = c->get();
+    out.emplace(std::move(*p));
+    p->~T();
+    c->seq.store(pos + mask + 1, std::memory_order_release);
+    wake(sleeping_producers, pop_epoch);
+    return true;
+  }
+
+  // Wakes the threads parked on the other side, if there are any. The
+  // fence orders the slot publication before the sleeper check, pairing
+  // with the increment in wait_for: either the sleeper sees the slot or
+  // this thread sees the sleeper.
+  static void wake(std::atomic<uint32_t>& sleepers, std::atomic<uint32_t>& epoch) noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) != 0) {
+      epoch.fetch_add(1, std::memory_order_release);
+      epoch.notify_all();
+    }
+  }
+
+  // Retries attempt() until it succeeds: first spinning, then parking on
+  // epoch, which the other side bumps whenever it frees a slot or
+  // publishes an element while someone sleeps.
+  template <typename Attempt>
+  static void wait_for(std::atomic<uint32_t>& sleepers, std::atomic<uint32_t>& epoch, Attempt attempt) {
+    for (int i = 0; i < spin_limit; ++i) {
+      if (attempt()) {
+        return;
+      }
+      cpu_relax();
+    }
+    for (;;) {
+      sleepers.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      uint32_t e = epoch.load(std::memory_order_acquire);
+      if (attempt()) {
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return;
+      }
+      epoch.wait(e, std::memory_order_acquire);
+      sleepers.fetch_sub(1, std::memory_order_relaxed);
+      if (attempt()) {
+        return;
+      }
+    }
+  }
+
+  static void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  // Read-only after construction, shared by all threads.
+  size_t const mask;
+  cell* const cells;
+
+  // Claimed by producers.
+  alignas(cache_line) std::atomic<size_t> enqueue_pos;
+  std::atomic<uint32_t> sleeping_consumers;
+  std::atomic<uint32_t> push_epoch;
+
+  // Claimed by consumers.
+  alignas(cache_line) std::atomic<size_t> dequeue_pos;
+  std::atomic<uint32_t> sleeping_producers;
+  std::atomic<uint32_t> pop_epoch;
+};
@@ -0,0 +1,282 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "circular_buffer.h"
+
+// Ring buffer whose whole state lives in a memory-mapped file or POSIX
+// shared memory segment, so that processes mapping the same segment share
+// it without copying, and a persisted buffer reopens with its contents.
+//
+// The segment holds a header with the power-of-two capacity and the
+// free-running read/write positions, followed by the slots. Nothing in it
+// is a pointer: each process computes slot addresses from its own mapping,
+// so the segment may be mapped at different addresses. Like
+// spsc_circular_buffer, one producer and one consumer may work on it
+// concurrently, from the same or different processes.
+//
+// T must be trivially copyable, since the bytes outlive this process.
+template <typename T>
+struct shm_circular_buffer {
+  static_assert(std::is_trivially_copyable_v<T>, "shm_circular_buffer needs a trivially copyable T");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "positions must be address-free atomics");
+
+  static constexpr size_t cache_line = 64;
+
+  // Creates (or truncates) the file at path with room for capacity
+  // elements, rounded up to a power of two.
+  static shm_circular_buffer create(char const* path, size_t capacity) {
+    return create_from(check(::open(path, O_RDWR | O_CREAT | O_TRUNC, 0600), "open"), capacity);
+  }
+  // Maps an existing file with its contents.
+  static shm_circular_buffer open(char const* path) {
+    return open_from(check(::open(path, O_RDWR), "open"));
+  }
+
+  // Same with POSIX shared memory, name being "/something".
+  static shm_circular_buffer create_shm(char const* name, size_t capacity) {
+    return create_from(check(::shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600), "shm_open"), capacity);
+  }
+  static shm_circular_buffer open_shm(char const* name) {
+    return open_from(check(::shm_open(name, O_RDWR, 0), "shm_open"));
+  }
+  static void remove_shm(char const* name) noexcept {
+    ::shm_unlink(name);
+  }
+
+  shm_circular_buffer(shm_circular_buffer const&) = delete;
+  shm_circular_buffer& operator=(shm_circular_buffer const&) = delete;
+
+  shm_circular_buffer(shm_circular_buffer&& other) noexcept
+    : base(std::exchange(other.base, nullptr))
+    , length(std::exchange(other.length, 0))
+    , cached_read_pos(other.cached_read_pos)
+    , cached_write_pos(other.cached_write_pos)
+  {}
+  shm_circular_buffer& operator=(shm_circular_buffer&& other) noexcept {
+    shm_circular_buffer moved(std::move(other));
+    std::swap(base, moved.base);
+    std::swap(length, moved.length);
+    std::swap(cached_read_pos, moved.cached_read_pos);
+    std::swap(cached_write_pos, moved.cached_write_pos);
+    return *this;
+  }
+
+  // Unmaps the segment; its contents stay in the file or shm object.
+  ~shm_circular_buffer() {
+    if (base != nullptr) {
+      ::munmap(base, length);
+    }
+  }
+
+  // Flushes a file-backed segment to disk.
+  void sync() {                                  // O(n)
+    check(::msync(base, length, MS_SYNC), "msync");
+  }
+
+  size_t capacity() const noexcept {             // O(1)
+    return hdr().capacity;
+  }
+  size_t size() const noexcept {                 // O(1), approximate
+    return hdr().write_pos.load(std::memory_order_acquire) - hdr().read_pos.load(std::memory_order_acquire);
+  }
+
+  // Producer side.
+
+  bool try_push_back(T const& val) noexcept {    // O(1)
+    return try_push_n(&val, 1) == 1;
+  }
+  // Copies up to n elements into the free slots and publishes them with
+  // a single store. Returns the number of elements pushed.
+  size_t try_push_n(T const* items, size_t n) noexcept { // O(n)
+    uint64_t w = hdr().write_pos.load(std::memory_order_relaxed);
+    size_t k = std::min(n, free_slots(w, n));
+    if (k == 0) {
+      return 0;
+    }
+    size_t pos = w & mask();
+    size_t first_len = std::min(k, capacity() - pos);
+    std::memcpy(slots() + pos, items, first_len * sizeof(T));
+    std::memcpy(slots(), items + first_len, (k - first_len) * sizeof(T));
+    hdr().write_pos.store(w + k, std::memory_order_release);
+    return k;
+  }
+  size_t try_push_n(std::span<T const> items) noexcept { // O(n)
+    return try_push_n(items.data(), items.size());
+  }
+
+  // Consumer side.
+
+  bool empty() const noexcept {                  // O(1)
+    return hdr().read_pos.load(std::memory_order_relaxed) ==
+           hdr().write_pos.load(std::memory_order_acquire);
+  }
+  T const& front() const noexcept {              // O(1), requires !empty()
+    return slots()[hdr().read_pos.load(std::memory_order_relaxed) & mask()];
+  }
+  void pop_front() noexcept {                    // O(1), requires !empty()
+    uint64_t r = hdr().read_pos.load(std::memory_order_relaxed);
+    hdr().read_pos.store(r + 1, std::memory_order_release);
+  }
+  bool try_pop_front(T& out) noexcept {          // O(1)
+    return try_pop_n(&out, 1) == 1;
+  }
+  // Copies up to n elements out and frees their slots with a single
+  // store. Returns the number of elements popped.
+  size_t try_pop_n(T* out, size_t n) noexcept {  // O(n)
+    uint64_t r = hdr().read_pos.load(std::memory_order_relaxed);
+    auto [one, two] = readable(n);
+    std::memcpy(out, one.data(), one.size_bytes());
+    std::memcpy(out + one.size(), two.data(), two.size_bytes());
+    size_t k = one.size() + two.size();
+    hdr().read_pos.store(r + k, std::memory_order_release);
+    return k;
+  }
+
+  // Up to n published elements in place, as at most two contiguous
+  // regions in order, read from one snapshot of the producer position
+  // like spsc_circular_buffer::peek. They stay valid until the consumer
+  // consumes or pops them.
+  std::pair<std::span<T const>, std::span<T const>> peek(size_t n) noexcept { // O(1)
+    return readable(n);
+  }
+  // Frees the first k elements, which a previous peek must have returned.
+  void consume(size_t k) noexcept {              // O(1)
+    uint64_t r = hdr().read_pos.load(std::memory_order_relaxed);
+    hdr().read_pos.store(r + k, std::memory_order_release);
+  }
+
+private:
+  static constexpr uint64_t magic = 0x43495243'42554646;  // "CIRCBUFF"
+  static constexpr uint32_t version = 1;
+
+  struct header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t element_size;
+    uint64_t capacity;
+
+    alignas(cache_line) std::atomic<uint64_t> write_pos;
+    alignas(cache_line) std::atomic<uint64_t> read_pos;
+  };
+
+  // The slots start on the first cache line (or alignof(T) boundary)
+  // after the header.
+  static constexpr size_t data_align = std::max(cache_line, alignof(T));
+  static constexpr size_t data_offset = (sizeof(header) + data_align - 1) / data_align * data_align;
+
+  shm_circular_buffer(void* _base, size_t _length) noexcept
+    : base(_base)
+    , length(_length)
+    , cached_read_pos(hdr().read_pos.load(std::memory_order_acquire))
+    , cached_write_pos(hdr().write_pos.load(std::memory_order_acquire))
+  {}
+
+  static int check(int rc, char const* what) {
+    if (rc < 0) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+    return rc;
+  }
+
+  // Maps the whole of fd, which is closed either way.
+  static void* map(int fd, size_t len) {
+    void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      throw std::system_error(err, std::generic_category(), "mmap");
+    }
+    return p;
+  }
+
+  static shm_circular_buffer create_from(int fd, size_t capacity) {
+    size_t slot_count = cb::detail::slots_for(std::max<size_t>(capacity, 1), true);
+    size_t len = data_offset + slot_count * sizeof(T);
+    if (::ftruncate(fd, static_cast<off_t>(len)) < 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "ftruncate");
+    }
+    void* p = map(fd, len);
+    new (p) header{magic, version, sizeof(T), slot_count, {0}, {0}};
+    return shm_circular_buffer(p, len);
+  }
+
+  static shm_circular_buffer open_from(int fd) {
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "fstat");
+    }
+    size_t len = static_cast<size_t>(st.st_size);
+    if (len < data_offset) {
+      ::close(fd);
+      throw std::runtime_error("shm_circular_buffer: segment too small");
+    }
+    shm_circular_buffer buf(map(fd, len), len);
+    header const& h = buf.hdr();
+    if (h.magic != magic || h.version != version || h.element_size != sizeof(T) ||
+        h.capacity == 0 || (h.capacity & (h.capacity - 1)) != 0 ||
+        len < data_offset + h.capacity * sizeof(T)) {
+      throw std::runtime_error("shm_circular_buffer: segment has a different layout");
+    }
+    return buf;
+  }
+
+  header& hdr() const noexcept {
+    return *static_cast<header*>(base);
+  }
+  T* slots() const noexcept {
+    return reinterpret_cast<T*>(static_cast<unsigned char*>(base) + data_offset);
+  }
+  size_t mask() const noexcept {
+    return hdr().capacity - 1;
+  }
+
+  // Producer only. Re-reads the consumer position only when the cached
+  // one shows fewer than wanted free slots.
+  size_t free_slots(uint64_t w, size_t wanted) noexcept {
+    if (capacity() - (w - cached_read_pos) < wanted) {
+      cached_read_pos = hdr().read_pos.load(std::memory_order_acquire);
+    }
+    return capacity() - (w - cached_read_pos);
+  }
+
+  // Consumer only. Up to n published elements from the front. As in
+  // spsc_circular_buffer, a cached count above capacity() is stale.
+  std::pair<std::span<T const>, std::span<T const>> readable(size_t n) noexcept {
+    uint64_t r = hdr().read_pos.load(std::memory_order_relaxed);
+    uint64_t used = cached_write_pos - r;
+    if (used < n || used > capacity()) {
+      cached_write_pos = hdr().write_pos.load(std::memory_order_acquire);
+    }
+    size_t k = std::min<uint64_t>(n, cached_write_pos - r);
+    size_t pos = r & mask();
+    size_t first_len = std::min(k, capacity() - pos);
+    return {std::span<T const>(slots() + pos, first_len), std::span<T const>(slots(), k - first_len)};
+  }
+
+  void* base;
+  size_t length;
+
+  // Local to this process.
+  uint64_t cached_read_pos;
+  uint64_t cached_write_pos;
+};
@@ -0,0 +1,480 @@
+#pragma once
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "circular_buffer.h"
+
+// Structure-of-arrays ring for records of several fields, e.g.
+// soa_circular_buffer<int64_t, double, int32_t, char> for {ts, price, qty,
+// side}: each field lives in its own ring array, all sharing one head,
+// size and power-of-two capacity, so a scan of one field reads only that
+// field's cache lines.
+//
+// column<I>() views one field as a buffer with array_one()/array_two(),
+// the contiguous segments in logical order, which is what the segment
+// algorithms and cb::sum/cb::mean take; the columns are 64-byte aligned
+// (cb::aligned_allocator). Whole records are read and written through
+// tuples of references: operator[], front(), back() and the iterators
+// return std::tuple<Fields&...>, which binds with structured bindings and
+// assigns from std::tuple<Fields...>. The iterators are random access
+// like circular_buffer's, but operator-> is not provided and algorithms
+// that swap elements (std::sort) don't work through the proxy.
+//
+// Fields must be trivially copyable; storage is copied with memcpy.
+template <typename... Fields>
+struct soa_circular_buffer {
+  static_assert(sizeof...(Fields) > 0, "soa_circular_buffer needs at least one field");
+  static_assert((std::is_trivially_copyable_v<Fields> && ...),
+                "soa_circular_buffer needs trivially copyable fields");
+
+  template <size_t I>
+  using field_type = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+  using value_type = std::tuple<Fields...>;
+  using reference = std::tuple<Fields&...>;
+  using const_reference = std::tuple<Fields const&...>;
+
+  template <typename Buffer>
+  struct basic_iterator;
+
+  using iterator = basic_iterator<soa_circular_buffer>;
+  using const_iterator = basic_iterator<soa_circular_buffer const>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  // One field of the buffer, with the array_one()/array_two() interface
+  // of circular_buffer. Valid until the buffer reallocates.
+  template <typename U>
+  struct column_view {
+    std::span<U> array_one() const noexcept { // O(1)
+      return one;
+    }
+    std::span<U> array_two() const noexcept { // O(1)
+      return two;
+    }
+    size_t size() const noexcept {            // O(1)
+      return one.size() + two.size();
+    }
+
+    std::span<U> one;
+    std::span<U> two;
+  };
+
+  soa_circular_buffer() noexcept               // O(1)
+    : head(0)
+    , sz(0)
+    , cap(0)
+    , cols()
+  {}
+
+  soa_circular_buffer(soa_circular_buffer const& other) // O(n), strong
+    : soa_circular_buffer()
+  {
+    if (other.sz > 0) {
+      cols = allocate_columns(slots_for(other.sz));
+      cap = slots_for(other.sz);
+      other.copy_to(cols);
+      sz = other.sz;
+    }
+  }
+
+  soa_circular_buffer(soa_circular_buffer&& other) noexcept // O(1)
+    : head(std::exchange(other.head, 0))
+    , sz(std::exchange(other.sz, 0))
+    , cap(std::exchange(other.cap, 0))
+    , cols(std::exchange(other.cols, columns()))
+  {}
+
+  ~soa_circular_buffer() {                     // O(1)
+    deallocate_columns(cols, cap);
+  }
+
+  soa_circular_buffer& operator=(soa_circular_buffer const& other) { // O(n), strong
+    if (this != &other) {
+      soa_circular_buffer copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+  soa_circular_buffer& operator=(soa_circular_buffer&& other) noexcept { // O(1)
+    soa_circular_buffer moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  size_t size() const noexcept {               // O(1)
+    return sz;
+  }
+  size_t capacity() const noexcept {           // O(1)
+    return cap;
+  }
+  bool empty() const noexcept {                // O(1)
+    return sz == 0;
+  }
+  void clear() noexcept {                      // O(1)
+    sz = 0;
+    head = 0;
+  }
+
+  // Rounded up to a power of two.
+  void reserve(size_t desired_capacity) {      // O(n), strong
+    if (desired_capacity > cap) {
+      reallocate(slots_for(desired_capacity));
+    }
+  }
+
+  reference operator[](size_t index) noexcept {             // O(1)
+    return record(get_arr_pos(index));
+  }
+  const_reference operator[](size_t index) const noexcept { // O(1)
+    return record(get_arr_pos(index));
+  }
+  // Field I of the element at index.
+  template <size_t I>
+  field_type<I>& get(size_t index) noexcept {               // O(1)
+    return std::get<I>(cols)[get_arr_pos(index)];
+  }
+  template <size_t I>
+  field_type<I> const& get(size_t index) const noexcept {   // O(1)
+    return std::get<I>(cols)[get_arr_pos(index)];
+  }
+
+  reference front() noexcept {                 // O(1)
+    return (*this)[0];
+  }
+  const_reference front() const noexcept {     // O(1)
+    return (*this)[0];
+  }
+  reference back() noexcept {                  // O(1)
+    return (*this)[sz - 1];
+  }
+  const_reference back() const noexcept {      // O(1)
+    return (*this)[sz - 1];
+  }
+
+  void push_back(Fields const&... fields) {    // O(1), strong
+    if (sz == cap) {
+      grow_and_store(false, fields...);
+    } else {
+      store(get_arr_pos(sz), fields...);
+    }
+    ++sz;
+  }
+  void push_back(value_type const& val) {      // O(1), strong
+    std::apply([this](Fields const&... fields) {
+      push_back(fields...);
+    }, val);
+  }
+  void pop_back() noexcept {                   // O(1)
+    --sz;
+  }
+  void pop_back(size_t n) noexcept {           // O(1)
+    assert(n <= sz);
+    sz -= n;
+  }
+
+  void push_front(Fields const&... fields) {   // O(1), strong
+    if (sz == cap) {
+      grow_and_store(true, fields...);
+    } else {
+      head = (head + cap - 1) & (cap - 1);
+      store(head, fields...);
+    }
+    ++sz;
+  }
+  void push_front(value_type const& val) {     // O(1), strong
+    std::apply([this](Fields const&... fields) {
+      push_front(fields...);
+    }, val);
+  }
+  void pop_front() noexcept {                  // O(1)
+    pop_front(1);
+  }
+  void pop_front(size_t n) noexcept {          // O(1)
+    assert(n <= sz);
+    if (n > 0) {
+      head = get_arr_pos(n);
+      sz -= n;
+    }
+  }
+
+  // Field I as a buffer of its own, for the segment algorithms.
+  template <size_t I>
+  column_view<field_type<I>> column() noexcept {             // O(1)
+    return {array_one<I>(), array_two<I>()};
+  }
+  template <size_t I>
+  column_view<field_type<I> const> column() const noexcept { // O(1)
+    return {array_one<I>(), array_two<I>()};
+  }
+
+  // The contiguous segments of field I, as circular_buffer::array_one()
+  // and array_two().
+  template <size_t I>
+  std::span<field_type<I>> array_one() noexcept {             // O(1)
+    return std::span<field_type<I>>(std::get<I>(cols) + head, first_segment_len());
+  }
+  template <size_t I>
+  std::span<field_type<I> const> array_one() const noexcept { // O(1)
+    return std::span<field_type<I> const>(std::get<I>(cols) + head, first_segment_len());
+  }
+  template <size_t I>
+  std::span<field_type<I>> array_two() noexcept {             // O(1)
+    return std::span<field_type<I>>(std::get<I>(cols), sz - first_segment_len());
+  }
+  template <size_t I>
+  std::span<field_type<I> const> array_two() const noexcept { // O(1)
+    return std::span<field_type<I> const>(std::get<I>(cols), sz - first_segment_len());
+  }
+
+  iterator begin() noexcept {                  // O(1)
+    return iterator(this, 0);
+  }
+  const_iterator begin() const noexcept {      // O(1)
+    return const_iterator(this, 0);
+  }
+  iterator end() noexcept {                    // O(1)
+    return iterator(this, sz);
+  }
+  const_iterator end() const noexcept {        // O(1)
+    return const_iterator(this, sz);
+  }
+
+  reverse_iterator rbegin() noexcept {               // O(1)
+    return reverse_iterator(end());
+  }
+  const_reverse_iterator rbegin() const noexcept {   // O(1)
+    return const_reverse_iterator(end());
+  }
+  reverse_iterator rend() noexcept {                 // O(1)
+    return reverse_iterator(begin());
+  }
+  const_reverse_iterator rend() const noexcept {     // O(1)
+    return const_reverse_iterator(begin());
+  }
+
+  void swap(soa_circular_buffer& other) noexcept { // O(1)
+    std::swap(head, other.head);
+    std::swap(sz, other.sz);
+    std::swap(cap, other.cap);
+    std::swap(cols, other.cols);
+  }
+
+private:
+  using columns = std::tuple<Fields*...>;
+  using indexes = std::index_sequence_for<Fields...>;
+
+  size_t head;
+  size_t sz;
+  size_t cap;
+  columns cols;
+
+  size_t grown_cap() const noexcept {
+    return cb::grow_2x::next_capacity(cap);
+  }
+  static constexpr size_t slots_for(size_t n) noexcept {
+    return cb::detail::slots_for(n, true);
+  }
+  size_t get_arr_pos(size_t index) const noexcept {
+    return (head + index) & (cap - 1);
+  }
+  size_t first_segment_len() const noexcept {
+    return std::min(sz, cap - head);
+  }
+
+  reference record(size_t pos) noexcept {
+    return std::apply([pos](Fields*... col) {
+      return reference(col[pos]...);
+    }, cols);
+  }
+  const_reference record(size_t pos) const noexcept {
+    return std::apply([pos](Fields*... col) {
+      return const_reference(col[pos]...);
+    }, cols);
+  }
+
+  void store(size_t pos, Fields const&... fields) noexcept {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      ((std::get<I>(cols)[pos] = fields), ...);
+    }(indexes{});
+  }
+
+  // The fields are copied first, since they may refer to elements of
+  // this buffer. Does not bump sz; the caller does.
+  void grow_and_store(bool at_front, Fields const&... fields) {
+    value_type val(fields...);
+    reallocate(grown_cap());
+    size_t pos = at_front ? cap - 1 : sz;
+    std::apply([this, pos](Fields const&... copied) {
+      store(pos, copied...);
+    }, val);
+    if (at_front) {
+      head = pos;
+    }
+  }
+
+  // Each column gets its own allocation; they are all made before any is
+  // used, and a failure frees the ones already made.
+  static columns allocate_columns(size_t n) {
+    columns out{};
+    try {
+      std::apply([n](auto*&... col) {
+        ((col = cb::aligned_allocator<std::remove_reference_t<decltype(*col)>>().allocate(n)), ...);
+      }, out);
+    } catch (...) {
+      deallocate_columns(out, n);
+      throw;
+    }
+    return out;
+  }
+  static void deallocate_columns(columns const& c, size_t n) noexcept {
+    std::apply([n](auto*... col) {
+      ((col != nullptr ? cb::aligned_allocator<std::remove_reference_t<decltype(*col)>>().deallocate(col, n)
+                       : void()), ...);
+    }, c);
+  }
+
+  // Copies the elements, in logical order, to the start of dest.
+  void copy_to(columns const& dest) const noexcept {
+    size_t first_len = first_segment_len();
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      ((std::memcpy(std::get<I>(dest), std::get<I>(cols) + head, first_len * sizeof(Fields)),
+        std::memcpy(std::get<I>(dest) + first_len, std::get<I>(cols), (sz - first_len) * sizeof(Fields))), ...);
+    }(indexes{});
+  }
+
+  void reallocate(size_t new_slots) {
+    columns new_cols = allocate_columns(new_slots);
+    if (sz > 0) {
+      copy_to(new_cols);
+    }
+    deallocate_columns(cols, cap);
+    cols = new_cols;
+    cap = new_slots;
+    head = 0;
+  }
+};
+
+// Random access over the records, holding the buffer and a logical index;
+// dereferencing yields the tuple of references for that record.
+template <typename... Fields>
+template <typename Buffer>
+struct soa_circular_buffer<Fields...>::basic_iterator
+{
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = std::tuple<Fields...>;
+  using difference_type = ptrdiff_t;
+  using pointer = void;
+  using reference = std::conditional_t<std::is_const_v<Buffer>, std::tuple<Fields const&...>,
+                                       std::tuple<Fields&...>>;
+
+  basic_iterator() = default;
+  basic_iterator(basic_iterator const&) = default;
+  basic_iterator& operator=(basic_iterator const&) = default;
+
+  template <typename B, typename = std::enable_if_t<std::is_const_v<Buffer> && !std::is_const_v<B>>>
+  basic_iterator(basic_iterator<B> const& other)
+    : buf(other.buf)
+    , index(other.index)
+  {}
+
+  reference operator*() const {
+    return (*buf)[index];
+  }
+
+  basic_iterator& operator++() & {
+    ++index;
+    return *this;
+  }
+  basic_iterator operator++(int) & {
+    basic_iterator copy(*this);
+    ++*this;
+    return copy;
+  }
+
+  basic_iterator& operator--() & {
+    --index;
+    return *this;
+  }
+  basic_iterator operator--(int) & {
+    basic_iterator copy(*this);
+    --*this;
+    return copy;
+  }
+
+  friend bool operator==(basic_iterator const& a, basic_iterator const& b) {
+    return a.index == b.index;
+  }
+
+  friend bool operator!=(basic_iterator const& a, basic_iterator const& b) {
+    return !(a == b);
+  }
+
+  friend bool operator<(basic_iterator const& a, basic_iterator const& b) {
+    return a.index < b.index;
+  }
+
+  friend bool operator>(basic_iterator const& a, basic_iterator const& b) {
+    return a.index > b.index;
+  }
+
+  friend bool operator<=(basic_iterator const& a, basic_iterator const& b) {
+    return a.index <= b.index;
+  }
+
+  friend bool operator>=(basic_iterator const& a, basic_iterator const& b) {
+    return a.index >= b.index;
+  }
+
+  reference operator[](difference_type k) const {  // O(1)
+    return *(*this + k);
+  }
+
+  basic_iterator& operator+=(difference_type k) {
+    index += k;
+    return *this;
+  }
+
+  basic_iterator& operator-=(difference_type k) {
+    return *this += -k;
+  }
+
+  friend basic_iterator operator+(basic_iterator it, difference_type k) {
+    it += k;
+    return it;
+  }
+
+  friend basic_iterator operator-(basic_iterator it, difference_type k) {
+    it -= k;
+    return it;
+  }
+
+  friend basic_iterator operator+(difference_type k, basic_iterator it) {
+    it += k;
+    return it;
+  }
+
+  friend difference_type operator-(basic_iterator const& a, basic_iterator const& b) {
+    return static_cast<difference_type>(a.index - b.index);
+  }
+
+private:
+  basic_iterator(Buffer* _buf, size_t _index)
+    : buf(_buf)
+    , index(_index)
+  {}
+
+  Buffer* buf = nullptr;
+  size_t index = 0;
+
+  template <typename B>
+  friend struct basic_iterator;
+  friend struct soa_circular_buffer<Fields...>;
+};
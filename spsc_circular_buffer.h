@@ -0,0 +1,243 @@
+#pragma once
+#include <atomic>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Uses the power-of-two layout of circular_buffer_pow2, but with
+// free-running read/write positions instead of a head and a size, so each
+// side owns the one index it writes.
+//
+// Producer side: push_back, emplace_back, try_push_back, try_emplace_back,
+// try_push_n, prepare/commit. Consumer side: empty, front, pop_front,
+// try_pop_front, try_pop_n, peek/consume. size() may be called from either
+// side and is approximate.
+template <typename T>
+struct spsc_circular_buffer {
+  static constexpr size_t cache_line = 64;
+  // The slots start on a cache line, or at alignof(T) if that is larger.
+  static constexpr size_t storage_align = std::max(cache_line, alignof(T));
+
+  explicit spsc_circular_buffer(size_t capacity) // O(1)
+    : mask(round_up(capacity) - 1)
+    , arr(static_cast<T*>(operator new((mask + 1) * sizeof(T), std::align_val_t(storage_align))))
+    , write_pos(0)
+    , cached_read_pos(0)
+    , read_pos(0)
+    , cached_write_pos(0)
+  {}
+
+  spsc_circular_buffer(spsc_circular_buffer const&) = delete;
+  spsc_circular_buffer& operator=(spsc_circular_buffer const&) = delete;
+
+  ~spsc_circular_buffer() {                      // O(n)
+    size_t r = read_pos.load(std::memory_order_relaxed);
+    size_t w = write_pos.load(std::memory_order_relaxed);
+    for (; r != w; ++r) {
+      arr[r & mask].~T();
+    }
+    operator delete(arr, std::align_val_t(storage_align));
+  }
+
+  size_t capacity() const noexcept {             // O(1)
+    return mask + 1;
+  }
+  size_t size() const noexcept {                 // O(1), approximate
+    size_t r = read_pos.load(std::memory_order_acquire);
+    size_t w = write_pos.load(std::memory_order_acquire);
+    return w - r;
+  }
+
+  // Producer side.
+
+  template <typename... Args>
+  bool try_emplace_back(Args&&... args) {        // O(1), strong
+    size_t w = write_pos.load(std::memory_order_relaxed);
+    if (free_slots(w, 1) == 0) {
+      return false;
+    }
+    new (arr + (w & mask)) T(std::forward<Args>(args)...);
+    write_pos.store(w + 1, std::memory_order_release);
+    return true;
+  }
+  bool try_push_back(T const& val) {             // O(1), strong
+    return try_emplace_back(val);
+  }
+  bool try_push_back(T&& val) {                  // O(1), strong
+    return try_emplace_back(std::move(val));
+  }
+
+  // Spin until there is room.
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    while (!try_emplace_back(std::forward<Args>(args)...)) {
+    }
+  }
+  void push_back(T const& val) {
+    emplace_back(val);
+  }
+  void push_back(T&& val) {
+    emplace_back(std::move(val));
+  }
+
+  // Copies up to n elements starting at first into the free slots (at
+  // most two contiguous segments) and publishes them with a single store.
+  // Returns the number of elements pushed.
+  template <typename ForwardIt>
+  size_t try_push_n(ForwardIt first, size_t n) {   // O(n), strong
+    size_t w = write_pos.load(std::memory_order_relaxed);
+    size_t k = std::min(n, free_slots(w, n));
+    if (k == 0) {
+      return 0;
+    }
+    size_t pos = w & mask;
+    size_t first_len = std::min(k, capacity() - pos);
+    auto mid = first;
+    std::uninitialized_copy_n(first, first_len, arr + pos);
+    std::advance(mid, first_len);
+    try {
+      std::uninitialized_copy_n(mid, k - first_len, arr);
+    } catch (...) {
+      std::destroy_n(arr + pos, first_len);
+      throw;
+    }
+    write_pos.store(w + k, std::memory_order_release);
+    return k;
+  }
+  size_t try_push_n(std::span<T const> items) {  // O(n), strong
+    return try_push_n(items.begin(), items.size());
+  }
+
+  // Two-phase push for trivially copyable T: returns up to n free slots
+  // (fewer if the buffer is fuller) as at most two regions to write in
+  // place, then commit(k) publishes the first k of them with a single
+  // store. The regions stay valid until the commit.
+  std::pair<std::span<T>, std::span<T>> prepare(size_t n) noexcept // O(1)
+    requires std::is_trivially_copyable_v<T>
+  {
+    size_t w = write_pos.load(std::memory_order_relaxed);
+    size_t k = std::min(n, free_slots(w, n));
+    return regions(w, k);
+  }
+  void commit(size_t k) noexcept                 // O(1)
+    requires std::is_trivially_copyable_v<T>
+  {
+    size_t w = write_pos.load(std::memory_order_relaxed);
+    write_pos.store(w + k, std::memory_order_release);
+  }
+
+  // Consumer side.
+
+  bool empty() const noexcept {                  // O(1)
+    return read_pos.load(std::memory_order_relaxed) ==
+           write_pos.load(std::memory_order_acquire);
+  }
+  T& front() noexcept {                          // O(1), requires !empty()
+    return arr[read_pos.load(std::memory_order_relaxed) & mask];
+  }
+  void pop_front() noexcept {                    // O(1), requires !empty()
+    size_t r = read_pos.load(std::memory_order_relaxed);
+    arr[r & mask].~T();
+    read_pos.store(r + 1, std::memory_order_release);
+  }
+  bool try_pop_front(T& out) {                   // O(1)
+    size_t r = read_pos.load(std::memory_order_relaxed);
+    if (used_slots(r, 1) == 0) {
+      return false;
+    }
+    T& slot = arr[r & mask];
+    out = std::move(slot);
+    slot.~T();
+    read_pos.store(r + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves up to n elements out through out, segment by segment, and frees
+  // their slots with a single store. Returns the number of elements popped.
+  template <typename OutputIt>
+  size_t try_pop_n(OutputIt out, size_t n) {     // O(n)
+    size_t r = read_pos.load(std::memory_order_relaxed);
+    size_t k = std::min(n, used_slots(r, n));
+    if (k == 0) {
+      return 0;
+    }
+    size_t pos = r & mask;
+    size_t first_len = std::min(k, capacity() - pos);
+    out = std::move(arr + pos, arr + pos + first_len, out);
+    std::move(arr, arr + (k - first_len), out);
+    std::destroy_n(arr + pos, first_len);
+    std::destroy_n(arr, k - first_len);
+    read_pos.store(r + k, std::memory_order_release);
+    return k;
+  }
+
+  // Two-phase pop: returns up to n published elements as at most two
+  // regions to read in place, then consume(k) destroys the first k of them
+  // and frees their slots with a single store.
+  std::pair<std::span<T>, std::span<T>> peek(size_t n) noexcept { // O(1)
+    size_t r = read_pos.load(std::memory_order_relaxed);
+    size_t k = std::min(n, used_slots(r, n));
+    return regions(r, k);
+  }
+  void consume(size_t k) noexcept {              // O(k), O(1) for trivial T
+    size_t r = read_pos.load(std::memory_order_relaxed);
+    auto [one, two] = regions(r, k);
+    std::destroy(one.begin(), one.end());
+    std::destroy(two.begin(), two.end());
+    read_pos.store(r + k, std::memory_order_release);
+  }
+
+private:
+  static size_t round_up(size_t n) noexcept {
+    size_t slots = 1;
+    while (slots < n) {
+      slots <<= 1;
+    }
+    return slots;
+  }
+
+  // The k slots from free-running position p, split at the end of arr.
+  std::pair<std::span<T>, std::span<T>> regions(size_t p, size_t k) const noexcept {
+    size_t pos = p & mask;
+    size_t first_len = std::min(k, capacity() - pos);
+    return {std::span<T>(arr + pos, first_len), std::span<T>(arr, k - first_len)};
+  }
+
+  // Producer only. Re-reads the consumer position only when the cached
+  // one shows fewer than wanted free slots.
+  size_t free_slots(size_t w, size_t wanted) noexcept {
+    if (capacity() - (w - cached_read_pos) < wanted) {
+      cached_read_pos = read_pos.load(std::memory_order_acquire);
+    }
+    return capacity() - (w - cached_read_pos);
+  }
+
+  // Consumer only. Re-reads the producer position only when the cached
+  // one shows fewer than wanted elements. pop_front() after empty() moves
+  // r past the cached position, which then shows more than capacity().
+  size_t used_slots(size_t r, size_t wanted) noexcept {
+    size_t used = cached_write_pos - r;
+    if (used < wanted || used > capacity()) {
+      cached_write_pos = write_pos.load(std::memory_order_acquire);
+    }
+    return cached_write_pos - r;
+  }
+
+  // Read-only after construction, shared by both sides.
+  size_t const mask;
+  T* const arr;
+
+  // Written by the producer.
+  alignas(cache_line) std::atomic<size_t> write_pos;
+  size_t cached_read_pos;
+
+  // Written by the consumer.
+  alignas(cache_line) std::atomic<size_t> read_pos;
+  size_t cached_write_pos;
+};
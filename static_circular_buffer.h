@@ -0,0 +1,343 @@
+#pragma once
+#include <cassert>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+// Circular buffer with a compile-time capacity of N elements stored inside
+// the object: it never allocates, and every operation is constexpr. The
+// interface follows circular_buffer, so code can be templated over both.
+// Pushing into a full buffer overwrites the element at the opposite end,
+// like circular_buffer with a fixed capacity.
+template <typename T, size_t N>
+struct static_circular_buffer {
+  static_assert(N > 0, "static_circular_buffer needs a non-zero capacity");
+
+  template <typename U>
+  struct basic_iterator;
+
+  using iterator = basic_iterator<T>;
+  using const_iterator = basic_iterator<T const>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  constexpr static_circular_buffer() noexcept         // O(1)
+    : head(0)
+    , sz(0)
+  {}
+
+  constexpr static_circular_buffer(static_circular_buffer const& other) // O(n), strong
+    : static_circular_buffer()
+  {
+    for (size_t i = 0; i < other.sz; ++i) {
+      push_back(other[i]);
+    }
+  }
+
+  constexpr static_circular_buffer(static_circular_buffer&& other)      // O(n)
+      noexcept(std::is_nothrow_move_constructible_v<T>)
+    : static_circular_buffer()
+  {
+    for (size_t i = 0; i < other.sz; ++i) {
+      push_back(std::move(other[i]));
+    }
+    other.clear();
+  }
+
+  constexpr ~static_circular_buffer() {                // O(n)
+    clear();
+  }
+
+  constexpr static_circular_buffer& operator=(static_circular_buffer const& other) { // O(n), strong
+    if (this != &other) {
+      static_circular_buffer copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  constexpr static_circular_buffer& operator=(static_circular_buffer&& other)      // O(n)
+      noexcept(std::is_nothrow_move_constructible_v<T>) {
+    if (this != &other) {
+      clear();
+      for (size_t i = 0; i < other.sz; ++i) {
+        push_back(std::move(other[i]));
+      }
+      other.clear();
+    }
+    return *this;
+  }
+
+  static constexpr size_t capacity() noexcept {       // O(1)
+    return N;
+  }
+  constexpr size_t size() const noexcept {            // O(1)
+    return sz;
+  }
+  constexpr bool empty() const noexcept {             // O(1)
+    return sz == 0;
+  }
+  constexpr bool full() const noexcept {              // O(1)
+    return sz == N;
+  }
+
+  constexpr T& operator[](size_t index) noexcept {              // O(1)
+    return slots.items[get_arr_pos(index)];
+  }
+  constexpr T const& operator[](size_t index) const noexcept {  // O(1)
+    return slots.items[get_arr_pos(index)];
+  }
+
+  constexpr void clear() noexcept {                   // O(n), O(1) for trivial T
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (size_t i = 0; i < sz; ++i) {
+        std::destroy_at(slots.items + get_arr_pos(i));
+      }
+    }
+    sz = 0;
+    head = 0;
+  }
+
+  constexpr void push_back(T const& val) {            // O(1), strong, basic when full and T's move can throw
+    emplace_back(val);
+  }
+  constexpr void push_back(T&& val) {                 // O(1), strong, basic when full and T's move can throw
+    emplace_back(std::move(val));
+  }
+  // Overwrites front() when full: it is destroyed before the new element
+  // is moved into its slot, so it is lost if that move throws.
+  template <typename... Args>
+  constexpr T& emplace_back(Args&&... args) {         // O(1), strong, basic when full and T's move can throw
+    if (full()) {
+      T val(std::forward<Args>(args)...);
+      pop_front();
+      std::construct_at(slots.items + get_arr_pos(sz), std::move(val));
+    } else {
+      std::construct_at(slots.items + get_arr_pos(sz), std::forward<Args>(args)...);
+    }
+    ++sz;
+    return back();
+  }
+  constexpr void pop_back() noexcept {                // O(1)
+    std::destroy_at(slots.items + get_arr_pos(sz - 1));
+    --sz;
+  }
+  constexpr T& back() noexcept {                      // O(1)
+    return slots.items[get_arr_pos(sz - 1)];
+  }
+  constexpr T const& back() const noexcept {          // O(1)
+    return slots.items[get_arr_pos(sz - 1)];
+  }
+
+  constexpr void push_front(T const& val) {           // O(1), strong, basic when full and T's move can throw
+    emplace_front(val);
+  }
+  constexpr void push_front(T&& val) {                // O(1), strong, basic when full and T's move can throw
+    emplace_front(std::move(val));
+  }
+  // Overwrites back() when full, with the same caveat.
+  template <typename... Args>
+  constexpr T& emplace_front(Args&&... args) {        // O(1), strong, basic when full and T's move can throw
+    size_t pos = wrap(head + N - 1);
+    if (full()) {
+      T val(std::forward<Args>(args)...);
+      pop_back();
+      std::construct_at(slots.items + pos, std::move(val));
+    } else {
+      std::construct_at(slots.items + pos, std::forward<Args>(args)...);
+    }
+    head = pos;
+    ++sz;
+    return front();
+  }
+  constexpr void pop_front() noexcept {               // O(1)
+    std::destroy_at(slots.items + head);
+    head = wrap(head + 1);
+    --sz;
+  }
+  constexpr T& front() noexcept {                     // O(1)
+    return slots.items[head];
+  }
+  constexpr T const& front() const noexcept {         // O(1)
+    return slots.items[head];
+  }
+
+  // Same as circular_buffer::array_one/array_two.
+  constexpr std::span<T> array_one() noexcept {             // O(1)
+    return std::span<T>(slots.items + head, first_segment_len());
+  }
+  constexpr std::span<T const> array_one() const noexcept { // O(1)
+    return std::span<T const>(slots.items + head, first_segment_len());
+  }
+  constexpr std::span<T> array_two() noexcept {             // O(1)
+    return std::span<T>(slots.items, sz - first_segment_len());
+  }
+  constexpr std::span<T const> array_two() const noexcept { // O(1)
+    return std::span<T const>(slots.items, sz - first_segment_len());
+  }
+
+  constexpr iterator begin() noexcept {               // O(1)
+    return iterator(this, 0);
+  }
+  constexpr const_iterator begin() const noexcept {   // O(1)
+    return const_iterator(this, 0);
+  }
+  constexpr iterator end() noexcept {                 // O(1)
+    return iterator(this, sz);
+  }
+  constexpr const_iterator end() const noexcept {     // O(1)
+    return const_iterator(this, sz);
+  }
+
+  constexpr reverse_iterator rbegin() noexcept {               // O(1)
+    return reverse_iterator(end());
+  }
+  constexpr const_reverse_iterator rbegin() const noexcept {   // O(1)
+    return const_reverse_iterator(end());
+  }
+  constexpr reverse_iterator rend() noexcept {                 // O(1)
+    return reverse_iterator(begin());
+  }
+  constexpr const_reverse_iterator rend() const noexcept {     // O(1)
+    return const_reverse_iterator(begin());
+  }
+
+  constexpr void swap(static_circular_buffer& other)           // O(n)
+      noexcept(std::is_nothrow_move_constructible_v<T>) {
+    static_circular_buffer tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+private:
+  // Storage for N elements that are constructed and destroyed one by one,
+  // which a union member allows even during constant evaluation.
+  union storage {
+    constexpr storage() noexcept {}
+    constexpr ~storage() {}
+
+    T items[N];
+  };
+
+  storage slots;
+  size_t head;
+  size_t sz;
+
+  // pos < 2 * N. A power-of-two N becomes a mask, anything else a
+  // compare and subtract.
+  static constexpr size_t wrap(size_t pos) noexcept {
+    if constexpr ((N & (N - 1)) == 0) {
+      return pos & (N - 1);
+    } else {
+      return pos >= N ? pos - N : pos;
+    }
+  }
+
+  constexpr size_t get_arr_pos(size_t index) const noexcept {
+    return wrap(head + index);
+  }
+
+  constexpr size_t first_segment_len() const noexcept {
+    return std::min(sz, N - head);
+  }
+};
+
+template <typename T, size_t N>
+template <typename U>
+struct static_circular_buffer<T, N>::basic_iterator
+{
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = std::remove_const_t<U>;
+  using difference_type = ptrdiff_t;
+  using pointer = U*;
+  using reference = U&;
+
+  constexpr basic_iterator() = default;
+  constexpr basic_iterator(basic_iterator const&) = default;
+  constexpr basic_iterator& operator=(basic_iterator const&) = default;
+
+  template <typename V, typename = std::enable_if_t<std::is_const_v<U> && !std::is_const_v<V>>>
+  constexpr basic_iterator(basic_iterator<V> const& other)
+    : buf(other.buf)
+    , index(other.index)
+  {}
+
+  constexpr U& operator*() const {
+    return (*buf)[index];
+  }
+  constexpr U* operator->() const {
+    return &(*buf)[index];
+  }
+  constexpr reference operator[](difference_type k) const {  // O(1)
+    return (*buf)[index + k];
+  }
+
+  constexpr basic_iterator& operator++() & {
+    return *this += 1;
+  }
+  constexpr basic_iterator operator++(int) & {
+    basic_iterator copy(*this);
+    ++*this;
+    return copy;
+  }
+
+  constexpr basic_iterator& operator--() & {
+    return *this -= 1;
+  }
+  constexpr basic_iterator operator--(int) & {
+    basic_iterator copy(*this);
+    --*this;
+    return copy;
+  }
+
+  constexpr friend bool operator==(basic_iterator const& a, basic_iterator const& b) {
+    return a.buf == b.buf && a.index == b.index;
+  }
+  constexpr friend auto operator<=>(basic_iterator const& a, basic_iterator const& b) {
+    return a.index <=> b.index;
+  }
+
+  constexpr basic_iterator& operator+=(difference_type k) {
+    index += k;
+    return *this;
+  }
+  constexpr basic_iterator& operator-=(difference_type k) {
+    index -= k;
+    return *this;
+  }
+
+  constexpr friend basic_iterator operator+(basic_iterator it, difference_type k) {
+    it += k;
+    return it;
+  }
+  constexpr friend basic_iterator operator-(basic_iterator it, difference_type k) {
+    it -= k;
+    return it;
+  }
+  constexpr friend basic_iterator operator+(difference_type k, basic_iterator it) {
+    it += k;
+    return it;
+  }
+  constexpr friend difference_type operator-(basic_iterator const& a, basic_iterator const& b) {
+    return a.index - b.index;
+  }
+
+private:
+  using buffer = std::conditional_t<std::is_const_v<U>, static_circular_buffer const, static_circular_buffer>;
+
+  constexpr basic_iterator(buffer* _buf, size_t _index)
+    : buf(_buf)
+    , index(_index)
+  {}
+
+  buffer* buf = nullptr;
+  size_t index = 0;
+
+  template <typename V>
+  friend struct basic_iterator;
+  friend struct static_circular_buffer<T, N>;
+};
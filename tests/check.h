@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+// Test executables are plain programs run by ctest: CHECK aborts with the
+// failing expression, which ctest reports as a failed test.
+#define CHECK(cond)                                                         \
+  do {                                                                      \
+    if (!(cond)) {                                                          \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+                   #cond);                                                  \
+      std::abort();                                                         \
+    }                                                                       \
+  } while (0)
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "circular_buffer_algorithm.h"
+#include "static_circular_buffer.h"
+#include "check.h"
+
+namespace {
+
+// n elements 0..n-1 stored from physical slot `offset` of a 16-slot
+// buffer: offset 0 is unwrapped, offset + n > 16 wraps.
+circular_buffer<int> make(size_t n, size_t offset) {
+  circular_buffer<int> b;
+  b.set_fixed_capacity(16);
+  for (size_t i = 0; i < offset; ++i) {
+    b.push_back(-1);
+  }
+  b.pop_front(offset);
+  for (size_t i = 0; i < n; ++i) {
+    b.push_back(int(i));
+  }
+  CHECK(b.array_two().empty() == (offset + n <= 16));
+  return b;
+}
+
+// Each cb:: algorithm against the std one over the iterators.
+void check_algorithms(circular_buffer<int> const& b) {
+  std::vector<int> order;
+  cb::for_each(b, [&](int v) { order.push_back(v); });
+  CHECK(std::equal(order.begin(), order.end(), b.begin(), b.end()));
+
+  std::vector<int> out(b.size() + 1, 99);
+  auto end = cb::copy(b, out.begin());
+  CHECK(end == out.begin() + b.size() && out.back() == 99);
+  CHECK(std::equal(b.begin(), b.end(), out.begin()));
+
+  for (int v = -1; v <= int(b.size()); ++v) {
+    CHECK(cb::find(b, v) == std::find(b.begin(), b.end(), v));
+  }
+
+  CHECK(cb::accumulate(b, 0) == std::accumulate(b.begin(), b.end(), 0));
+  // A non-commutative op checks the order of the segments.
+  auto append = [](std::string s, int v) { return s + char('a' + v); };
+  CHECK(cb::accumulate(b, std::string(), append) == std::accumulate(b.begin(), b.end(), std::string(), append));
+
+  auto square = [](int v) { return long(v) * v; };
+  CHECK(cb::transform_reduce(b, 0L, std::plus<>(), square) ==
+        std::transform_reduce(b.begin(), b.end(), 0L, std::plus<>(), square));
+
+  std::vector<int> linear(b.begin(), b.end());
+  CHECK(cb::equal(b, std::span<int const>(linear)));
+  if (!linear.empty()) {
+    linear.back() = -5;
+    CHECK(!cb::equal(b, std::span<int const>(linear)));
+    linear.pop_back();
+  }
+  CHECK(!cb::equal(b, std::span<int const>(linear)) || b.empty());
+}
+
+void test_circular_buffer() {
+  for (size_t n : {0, 1, 5, 16}) {
+    for (size_t offset : {0, 3, 11, 15}) {
+      circular_buffer<int> b = make(n, offset);
+      check_algorithms(b);
+
+      // equal() lines up segments that split at different places.
+      for (size_t other_offset : {0, 7, 13}) {
+        circular_buffer<int> c = make(n, other_offset);
+        CHECK(cb::equal(b, c) == std::equal(b.begin(), b.end(), c.begin(), c.end()));
+        CHECK(cb::equal(b, c));
+        for (size_t i = 0; i < n; ++i) {
+          c[i] = 100;
+          CHECK(!cb::equal(b, c) && !std::equal(b.begin(), b.end(), c.begin(), c.end()));
+          c[i] = int(i);
+        }
+        if (n > 0) {
+          c.pop_back();
+          CHECK(!cb::equal(b, c));
+        }
+      }
+    }
+  }
+}
+
+void test_static_buffer() {
+  static_circular_buffer<int, 6> s;
+  for (int i = 0; i < 10; ++i) {
+    s.push_back(i);
+  }
+  CHECK(!s.array_two().empty());
+  CHECK(cb::accumulate(s, 0) == std::accumulate(s.begin(), s.end(), 0));
+  CHECK(cb::find(s, 7) == std::find(s.begin(), s.end(), 7));
+  CHECK(cb::find(s, 2) == s.end());
+  std::vector<int> out(6);
+  cb::copy(s, out.begin());
+  CHECK(std::equal(s.begin(), s.end(), out.begin()));
+  circular_buffer<int> b = make(6, 12);
+  for (int& v : b) {
+    v += 4;
+  }
+  CHECK(cb::equal(s, b) && cb::equal(b, s));
+}
+
+}  // namespace
+
+int main() {
+  test_circular_buffer();
+  test_static_buffer();
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "circular_buffer_io.h"
+#include "check.h"
+
+namespace {
+
+// Random-sized appends, writes and reads over a non-blocking socketpair,
+// then a drain to EOF: the bytes come out in the order they went in.
+void test_socketpair() {
+  int sv[2];
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  fcntl(sv[0], F_SETFL, O_NONBLOCK);
+  fcntl(sv[1], F_SETFL, O_NONBLOCK);
+  circular_buffer<char> tx;
+  circular_buffer<char> rx;
+  std::string sent;
+  std::string got;
+  unsigned seed = 1;
+  for (int round = 0; round < 3000; ++round) {
+    seed = seed * 1103515245 + 12345;
+    size_t n = seed % 700;
+    std::string chunk;
+    for (size_t i = 0; i < n; ++i) {
+      chunk.push_back(char('a' + (sent.size() + i) % 26));
+    }
+    tx.append(chunk.begin(), chunk.end());
+    sent += chunk;
+    ssize_t w = cb::write_to(tx, sv[0], 1 + seed % 900);
+    CHECK(w >= 0 || errno == EAGAIN);
+    ssize_t r = cb::read_from(rx, sv[1], 1 + seed % 500);
+    CHECK(r >= 0 || errno == EAGAIN);
+    size_t k = rx.size() / 2;
+    for (size_t i = 0; i < k; ++i) {
+      got.push_back(rx[i]);
+    }
+    rx.consume(k);
+  }
+
+  while (!tx.empty()) {
+    CHECK(cb::write_to(tx, sv[0], 65536) >= 0 || errno == EAGAIN);
+    CHECK(cb::read_from(rx, sv[1], 65536) >= 0 || errno == EAGAIN);
+  }
+  shutdown(sv[0], SHUT_WR);
+  fcntl(sv[1], F_SETFL, 0);
+  for (;;) {
+    ssize_t r = cb::read_from(rx, sv[1], 4096);
+    CHECK(r >= 0);
+    if (r == 0) {
+      break;
+    }
+  }
+  got.append(rx.begin(), rx.end());
+  rx.consume(rx.size());
+  CHECK(got == sent && rx.empty());
+  close(sv[0]);
+  close(sv[1]);
+}
+
+// A fixed-capacity ring reads only into its free space, across both
+// iovecs when the free space wraps.
+void test_fixed_capacity() {
+  circular_buffer<char> f;
+  f.set_fixed_capacity(10);
+  for (int i = 0; i < 7; ++i) {
+    f.push_back('x');
+  }
+  f.consume(5);
+  CHECK(f.free_array_one().size() + f.free_array_two().size() == 8);
+  CHECK(!f.free_array_two().empty());
+  int p[2];
+  CHECK(pipe(p) == 0);
+  CHECK(write(p[1], "0123456789abc", 13) == 13);
+  CHECK(cb::read_from(f, p[0], 100) == 8);
+  CHECK(f.size() == 10 && f.capacity() == 10 && f[2] == '0' && f[9] == '7');
+  CHECK(cb::write_to(f, p[1], 3) == 3);
+  CHECK(f.size() == 7 && f.front() == '1');
+  close(p[0]);
+  close(p[1]);
+}
+
+void test_consume() {
+  circular_buffer<std::string> s;
+  s.push_back("a");
+  s.push_back("b");
+  s.push_back("c");
+  s.consume(2);
+  CHECK(s.size() == 1 && s.front() == "c");
+  circular_buffer<int> e;
+  CHECK(e.free_array_one().empty() && e.free_array_two().empty());
+}
+
+// prepare() hands out the free slots in two spans when they wrap, commit()
+// may add fewer elements than were prepared, and a fixed capacity refuses
+// to prepare more than is free.
+void test_prepare_commit() {
+  circular_buffer<int> f;
+  f.set_fixed_capacity(10);
+  for (int i = 0; i < 8; ++i) {
+    f.push_back(i);
+  }
+  f.consume(6);  // 6 and 7 left in slots 6 and 7
+  auto [one, two] = f.prepare(6);
+  CHECK(one.size() == 2 && two.size() == 4);
+  CHECK(one.data() == f.free_array_one().data() && two.data() == f.free_array_two().data());
+  for (int i = 0; i < 2; ++i) {
+    one[i] = 10 + i;
+  }
+  for (int i = 0; i < 4; ++i) {
+    two[i] = 12 + i;
+  }
+  f.commit(5);  // the last prepared slot stays free
+  CHECK(f.size() == 7 && f.capacity() == 10 && !f.array_two().empty());
+  int want[] = {6, 7, 10, 11, 12, 13, 14};
+  CHECK(std::equal(f.begin(), f.end(), want, want + 7));
+
+  auto [three, four] = f.prepare(3);  // everything that is free
+  CHECK(three.size() == 3 && four.empty());
+  bool threw = false;
+  try {
+    f.prepare(4);
+  } catch (std::length_error const&) {
+    threw = true;
+  }
+  CHECK(threw && f.size() == 7 && f.capacity() == 10);
+  CHECK(std::equal(f.begin(), f.end(), want, want + 7));
+  f.commit(0);
+  CHECK(f.size() == 7);
+
+  circular_buffer<int> g;  // grows to fit instead
+  auto [five, six] = g.prepare(100);
+  CHECK(g.capacity() >= 100 && five.size() == 100 && six.empty());
+  five[0] = 42;
+  g.commit(1);
+  CHECK(g.size() == 1 && g.front() == 42);
+}
+
+}  // namespace
+
+int main() {
+  test_socketpair();
+  test_fixed_capacity();
+  test_consume();
+  test_prepare_commit();
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "circular_buffer_stats.h"
+#include "check.h"
+
+// Built once as is and once with -mavx2 (circular_buffer_stats_avx2_test),
+// so that both the scalar and the vector kernels are checked.
+#if defined(__AVX2__) && !defined(CB_STATS_AVX2)
+#error "an AVX2 build must use the AVX2 kernels"
+#endif
+
+namespace {
+
+std::mt19937 rng(11);
+
+template <typename T>
+T random_value() {
+  if constexpr (std::is_floating_point_v<T>) {
+    return static_cast<T>(std::uniform_real_distribution<double>(-100, 100)(rng));
+  } else {
+    return static_cast<T>(std::uniform_int_distribution<int64_t>(-1000000, 1000000)(rng));
+  }
+}
+
+// Closeness relative to the magnitude of the terms, since the kernels
+// add in a different order than the reference.
+template <typename T>
+bool close(long double got, long double want, long double scale) {
+  long double eps = std::is_same_v<T, float> ? 1e-5L : 1e-12L;
+  if constexpr (!std::is_floating_point_v<T>) {
+    eps = 0;
+  }
+  return std::fabs(got - want) <= eps * (scale + 1);
+}
+
+// n values starting at physical slot offset of a 96-slot buffer, so the
+// segments split anywhere and have any length modulo the vector width.
+template <typename T>
+void check_buffer(size_t n, size_t offset) {
+  circular_buffer<T> b;
+  b.set_fixed_capacity(96);
+  for (size_t i = 0; i < offset; ++i) {
+    b.push_back(T());
+  }
+  b.pop_front(offset);
+  std::vector<T> ref;
+  for (size_t i = 0; i < n; ++i) {
+    T v = random_value<T>();
+    b.push_back(v);
+    ref.push_back(v);
+  }
+
+  long double sum = 0;
+  long double abs_sum = 0;
+  for (T v : ref) {
+    sum += v;
+    abs_sum += std::fabs(static_cast<long double>(v));
+  }
+  CHECK(close<T>(cb::sum(b), sum, abs_sum));
+  if (n == 0) {
+    CHECK(cb::sum(b) == T());
+    return;
+  }
+  CHECK(cb::min_value(b) == *std::min_element(ref.begin(), ref.end()));
+  CHECK(cb::max_value(b) == *std::max_element(ref.begin(), ref.end()));
+  long double mean = sum / n;
+  // Integer means are a rounded division, so they are not exact either.
+  long double mean_eps = std::is_same_v<T, float> ? 1e-5L : 1e-9L;
+  CHECK(std::fabs(cb::mean(b) - mean) <= mean_eps * (abs_sum / n + 1));
+  long double sq = 0;
+  long double sq_scale = 0;
+  for (T v : ref) {
+    sq += (v - mean) * (v - mean);
+    sq_scale += static_cast<long double>(v) * v;
+  }
+  // The variance is accumulated in double for every T.
+  CHECK(std::fabs(cb::variance(b) - sq / n) <= 1e-9L * (sq_scale / n + 1));
+}
+
+template <typename T>
+void test_reductions() {
+  for (size_t n : {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 71, 96}) {
+    for (size_t offset : {0, 1, 5, 40, 93, 95}) {
+      check_buffer<T>(n, offset);
+    }
+  }
+  // A one-element buffer has itself as every statistic.
+  circular_buffer<T> one;
+  one.push_back(T(3));
+  CHECK(cb::sum(one) == T(3) && cb::min_value(one) == T(3) && cb::max_value(one) == T(3));
+  CHECK(cb::mean(one) == 3 && cb::variance(one) == 0);
+}
+
+// The rolling variance is downdated as values leave, so its rounding error
+// scales with the values that already left the window: keep them moderate.
+template <typename T>
+T rolling_value() {
+  if constexpr (std::is_floating_point_v<T>) {
+    return random_value<T>();
+  } else {
+    return static_cast<T>(std::uniform_int_distribution<int>(-1000, 1000)(rng));
+  }
+}
+
+// Each push against a recomputation over the last window values.
+template <typename T>
+void test_rolling(size_t window) {
+  cb::rolling_stats<T> r(window);
+  CHECK(r.window() == window && r.empty() && r.variance() == 0);
+  std::vector<T> all;
+  for (int i = 0; i < 500; ++i) {
+    T v = i % 50 < 10 ? T(i % 3) : rolling_value<T>();  // runs of repeats too
+    r.push_back(v);
+    all.push_back(v);
+    size_t n = std::min(all.size(), window);
+    std::vector<T> last(all.end() - n, all.end());
+    CHECK(r.size() == n);
+    CHECK(std::equal(r.buffer().begin(), r.buffer().end(), last.begin(), last.end()));
+    long double sum = 0;
+    long double abs_sum = 0;
+    for (T x : last) {
+      sum += x;
+      abs_sum += std::fabs(static_cast<long double>(x));
+    }
+    long double mean = sum / n;
+    long double sq = 0;
+    for (T x : last) {
+      sq += (x - mean) * (x - mean);
+    }
+    CHECK(r.min() == *std::min_element(last.begin(), last.end()));
+    CHECK(r.max() == *std::max_element(last.begin(), last.end()));
+    // Running updates drift, so these are looser than the kernels.
+    long double scale = abs_sum / n + 1;
+    if constexpr (std::is_floating_point_v<T>) {
+      CHECK(std::fabs(r.sum() - sum) <= 1e-3L * (abs_sum + 1));
+    } else {
+      CHECK(r.sum() == T(sum));
+    }
+    CHECK(std::fabs(r.mean() - mean) <= 1e-6L * scale);
+    CHECK(std::fabs(r.variance() - sq / n) <= 1e-6L * scale * scale);
+  }
+  while (!r.empty()) {
+    r.pop_front();
+  }
+  CHECK(r.mean() == 0 && r.variance() == 0);
+  if constexpr (!std::is_floating_point_v<T>) {
+    CHECK(r.sum() == T());
+  }
+}
+
+}  // namespace
+
+int main() {
+#if defined(CB_STATS_AVX2)
+  if (!__builtin_cpu_supports("avx2")) {
+    return 77;  // skipped, see tests/CMakeLists.txt
+  }
+#endif
+  test_reductions<double>();
+  test_reductions<float>();
+  test_reductions<int64_t>();
+  test_reductions<int>();
+  for (size_t window : {1, 5, 64}) {
+    test_rolling<double>(window);
+    test_rolling<int64_t>(window);
+  }
+  test_rolling<float>(8);
+}
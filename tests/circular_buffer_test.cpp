@@ -0,0 +1,544 @@
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "circular_buffer.h"
+#include "check.h"
+
+// Every member must compile for a non-trivially-copyable T, not only the
+// ones a test happens to call.
+template struct circular_buffer<std::string>;
+
+namespace {
+
+// Move may throw, so growth must copy it: moves and copies are counted, and
+// copying can be made to fail after a given number of copies.
+struct throwing_move {
+  static inline int copies = 0;
+  static inline int moves = 0;
+  static inline int copies_left = -1;  // -1: never throw
+
+  int value;
+
+  explicit throwing_move(int v) : value(v) {}
+  throwing_move(throwing_move const& other) : value(other.value) {
+    if (copies_left == 0) {
+      throw std::runtime_error("copy");
+    }
+    if (copies_left > 0) {
+      --copies_left;
+    }
+    ++copies;
+  }
+  throwing_move(throwing_move&& other) noexcept(false) : value(other.value) {
+    ++moves;
+  }
+  throwing_move& operator=(throwing_move const&) = default;
+  throwing_move& operator=(throwing_move&&) = default;
+};
+
+std::vector<int> values(circular_buffer<std::unique_ptr<int>> const& b) {
+  std::vector<int> out;
+  for (auto const& p : b) {
+    out.push_back(*p);
+  }
+  return out;
+}
+
+void test_move_only() {
+  circular_buffer<std::unique_ptr<int>> b;
+  // Growth relocates by moving; wrap first so both segments move.
+  for (int i = 0; i < 4; ++i) {
+    b.push_back(std::make_unique<int>(i));
+  }
+  b.pop_front();
+  b.pop_front();
+  for (int i = 4; i < 40; ++i) {
+    b.push_back(std::make_unique<int>(i));
+  }
+  b.push_front(std::make_unique<int>(1));
+  b.emplace_front(new int(0));
+  CHECK(b.size() == 40);
+  for (int i = 0; i < 40; ++i) {
+    CHECK(*b[i] == i);
+  }
+
+  auto it = b.insert(b.begin() + 10, std::make_unique<int>(100));
+  CHECK(**it == 100 && b.size() == 41);
+  it = b.insert(b.end() - 3, std::make_unique<int>(200));
+  CHECK(**it == 200 && *b[38] == 200 && *b[39] == 37);
+
+  it = b.erase(b.begin() + 10);
+  CHECK(**it == 10);
+  it = b.erase(b.begin() + 5, b.begin() + 8);
+  CHECK(**it == 8 && b.size() == 38);
+  b.erase(b.end() - 4);
+  CHECK(b.size() == 37);
+
+  std::vector<int> before = values(b);
+  std::unique_ptr<int>* p = b.linearize();
+  CHECK(p == b.array_one().data() && b.array_two().empty());
+  CHECK(values(b) == before);
+
+  circular_buffer<std::unique_ptr<int>> moved(std::move(b));
+  CHECK(moved.size() == 37 && b.empty());
+  CHECK(values(moved) == before);
+}
+
+void test_throwing_move_copies() {
+  circular_buffer<throwing_move> b;
+  b.reserve(4);
+  for (int i = 0; i < 4; ++i) {
+    b.emplace_back(i);
+  }
+  b.pop_front();
+  b.emplace_back(4);  // wraps
+  throwing_move::copies = 0;
+  throwing_move::moves = 0;
+  b.emplace_back(5);  // grows
+  CHECK(throwing_move::moves == 0);
+  CHECK(throwing_move::copies == 4);
+  CHECK(b.size() == 5);
+  for (int i = 0; i < 5; ++i) {
+    CHECK(b[i].value == i + 1);
+  }
+
+  // A copy failing half way through growth leaves the buffer as it was.
+  while (b.size() < b.capacity()) {
+    b.emplace_back(int(b.size()) + 1);
+  }
+  size_t cap = b.capacity();
+  size_t n = b.size();
+  throwing_move::copies_left = 3;
+  bool threw = false;
+  try {
+    b.emplace_back(0);
+  } catch (std::runtime_error const&) {
+    threw = true;
+  }
+  throwing_move::copies_left = -1;
+  CHECK(threw);
+  CHECK(b.capacity() == cap && b.size() == n);
+  for (size_t i = 0; i < n; ++i) {
+    CHECK(b[i].value == int(i) + 1);
+  }
+}
+
+// A full fixed-capacity buffer makes room for a range by dropping from the
+// opposite end.
+void test_fixed_append_prepend() {
+  circular_buffer<std::string> b;
+  b.set_fixed_capacity(5);
+  std::vector<std::string> items = {"a", "b", "c", "d"};
+  b.append(items.begin(), items.end());
+  b.append(items.begin(), items.begin() + 3);
+  CHECK(b.size() == 5 && b.front() == "c" && b.back() == "c");
+  b.prepend(items.begin(), items.begin() + 2);
+  CHECK(b.size() == 5 && b[0] == "a" && b[1] == "b" && b[2] == "c" && b[4] == "a");
+  std::vector<std::string> many = {"0", "1", "2", "3", "4", "5", "6"};
+  b.append(many.begin(), many.end());
+  CHECK(b.size() == 5 && b.front() == "2" && b.back() == "6");
+  b.prepend(many.begin(), many.end());
+  CHECK(b.size() == 5 && b.front() == "0" && b.back() == "4");
+  CHECK(b.capacity() == 5);
+}
+
+int reports = 0;
+cb::buffer_stats last_report;
+
+void count_report(cb::buffer_stats const& stats, void const*) {
+  ++reports;
+  last_report = stats;
+}
+
+// Only buffers that held something report; counters follow the storage
+// through moves, swaps and assignment.
+void test_stats() {
+  using buffer = instrumented_circular_buffer<int>;
+  cb::stats_callback previous = cb::set_stats_callback(count_report);
+  {
+    buffer a;
+    for (int i = 0; i < 10; ++i) {
+      a.push_back(i);
+    }
+    buffer b;
+    b.push_back(1);
+    b = a;  // no report for the temporary copy
+    CHECK(reports == 0);
+    CHECK(b.stats().peak_size == 10 && b.stats().pushes == 11 && b.stats().pops == 1);
+
+    buffer c(std::move(a));  // a is left with nothing to report
+    CHECK(c.stats().pushes == 10 && a.stats().pushes == 0);
+    buffer d;
+    d = std::move(c);
+    CHECK(d.stats().pushes == 10 && d.stats().peak_size == 10 && c.stats().pushes == 0);
+    d.swap(b);
+    CHECK(d.stats().pushes == 11 && b.stats().pushes == 10);
+
+    // Growing the vector moves the buffers, leaving empty shells behind.
+    std::vector<buffer> v;
+    for (int i = 0; i < 5; ++i) {
+      v.emplace_back().push_back(i);
+    }
+    CHECK(reports == 0);
+  }
+  // v's five buffers, then b and d.
+  CHECK(reports == 7);
+  CHECK(last_report.pushes == 10 && last_report.peak_size == 10);
+
+  reports = 0;
+  {
+    circular_buffer<int, std::allocator<int>, false, 4, cb::grow_2x, cb::counting_stats> a, b;
+    a.push_back(1);
+    a.push_back(2);
+    b.push_back(3);
+    a.swap(b);  // inline storage: elements are relocated, not counted
+    CHECK(a.stats().pushes == 1 && a.stats().pops == 0 && a.size() == 1 && a[0] == 3);
+    CHECK(b.stats().pushes == 2 && b.stats().pops == 0 && b.size() == 2);
+  }
+  CHECK(reports == 2);
+  cb::set_stats_callback(previous);
+}
+
+bool is_power_of_two(size_t n) {
+  return n != 0 && (n & (n - 1)) == 0;
+}
+
+// The mask-based wrap: capacities round up to a power of two, and indexing,
+// iteration and the segments agree with a deque through wraps and growth.
+void test_power_of_two() {
+  using buffer = circular_buffer<int, std::allocator<int>, true>;
+  buffer b;
+  b.reserve(5);
+  CHECK(b.capacity() == 8);
+  b.reserve(8);
+  CHECK(b.capacity() == 8);
+  b.reserve(9);
+  CHECK(b.capacity() == 16);
+  buffer f;
+  f.set_fixed_capacity(3);
+  CHECK(f.capacity() == 4);
+  for (int i = 0; i < 10; ++i) {
+    f.push_back(i);
+  }
+  CHECK(f.size() == 4 && f.front() == 6 && f.back() == 9);
+
+  buffer w;
+  std::deque<int> model;
+  for (int i = 0; i < 8; ++i) {
+    w.push_back(i);
+    model.push_back(i);
+  }
+  w.pop_front(5);
+  model.erase(model.begin(), model.begin() + 5);
+  for (int i = 8; i < 13; ++i) {  // wraps within 8 slots
+    w.push_back(i);
+    model.push_back(i);
+  }
+  CHECK(w.capacity() == 8 && !w.array_two().empty());
+  w.push_back(13);  // grows while wrapped
+  model.push_back(13);
+  CHECK(w.capacity() == 16);
+
+  unsigned seed = 7;
+  for (int i = 0; i < 5000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    switch ((seed >> 16) % 4) {
+    case 0:
+      w.push_front(i);
+      model.push_front(i);
+      break;
+    case 1:
+    case 2:
+      w.push_back(i);
+      model.push_back(i);
+      break;
+    default:
+      if (!model.empty()) {
+        w.pop_front();
+        model.pop_front();
+      }
+    }
+    CHECK(is_power_of_two(w.capacity()) && w.size() == model.size());
+    if (i % 97 == 0) {
+      CHECK(w.array_one().size() + w.array_two().size() == w.size());
+      for (size_t k = 0; k < model.size(); ++k) {
+        CHECK(w[k] == model[k] && w.begin()[k] == model[k]);
+      }
+      CHECK(std::equal(w.begin(), w.end(), model.begin(), model.end()));
+      CHECK(size_t(w.end() - w.begin()) == w.size());
+    }
+  }
+
+  circular_buffer<int, std::allocator<int>, true, 0, cb::grow_1_5x> g;
+  for (int i = 0; i < 1000; ++i) {
+    g.push_back(i);
+    CHECK(is_power_of_two(g.capacity()));
+  }
+  CHECK(g[999] == 999 && g[0] == 0);
+}
+
+// Leaves size elements in b without growing it, the first ten of them in
+// the last slots of the storage.
+template <typename Buffer>
+void fill_wrapped(Buffer& b, std::deque<int>& model, size_t size) {
+  int cap = int(b.capacity());
+  for (int i = 0; i < cap; ++i) {
+    b.push_back(i);
+  }
+  b.pop_front(cap - 10);
+  for (int i = cap; i < int(size) + cap - 10; ++i) {
+    b.push_back(i);
+  }
+  model.clear();
+  model.insert(model.end(), b.begin(), b.end());
+  CHECK(b.size() == size && !b.array_two().empty());
+}
+
+// shrink_to_fit goes down to size(), rounded up to a power of two with the
+// mask-based wrap, and keeps the order of a wrapped buffer.
+void test_shrink_to_fit() {
+  std::deque<int> model;
+  circular_buffer<int> b;
+  b.reserve(100);
+  fill_wrapped(b, model, 25);
+  b.shrink_to_fit();
+  CHECK(b.capacity() == 25 && std::equal(b.begin(), b.end(), model.begin(), model.end()));
+  b.push_back(1);  // still usable after the shrink
+  CHECK(b.capacity() > 25 && b.back() == 1 && b.front() == model.front());
+
+  circular_buffer<int, std::allocator<int>, true> p;
+  p.reserve(128);
+  fill_wrapped(p, model, 25);
+  p.shrink_to_fit();
+  CHECK(p.capacity() == 32 && std::equal(p.begin(), p.end(), model.begin(), model.end()));
+  p.clear();
+  p.shrink_to_fit();
+  CHECK(p.capacity() == 0 && p.empty());
+
+  circular_buffer<int> f;
+  f.set_fixed_capacity(100);
+  fill_wrapped(f, model, 25);
+  f.shrink_to_fit();  // a fixed capacity is kept
+  CHECK(f.capacity() == 100 && std::equal(f.begin(), f.end(), model.begin(), model.end()));
+}
+
+// auto_shrink halves the storage only once size() drops below
+// capacity() / shrink_divisor, and a size going back and forth across a
+// shrink or grow threshold does not reallocate every time.
+void test_auto_shrink() {
+  using buffer = circular_buffer<int, std::allocator<int>, false, 0, cb::auto_shrink<cb::grow_2x>,
+                                 cb::counting_stats>;
+  static_assert(cb::auto_shrink<cb::grow_2x>::shrink_divisor == 4);
+  buffer b;
+  b.reserve(64);
+  std::deque<int> model;
+  for (int i = 0; i < 64; ++i) {  // from the front, so it wraps
+    b.push_front(i);
+    model.push_front(i);
+  }
+  while (b.size() > 16) {
+    b.pop_back();
+    model.pop_back();
+    CHECK(b.capacity() == 64);
+  }
+  b.pop_back();  // 15 < 64 / 4
+  model.pop_back();
+  CHECK(b.capacity() == 32 && std::equal(b.begin(), b.end(), model.begin(), model.end()));
+
+  size_t reallocations = b.stats().reallocations;
+  for (int i = 0; i < 100; ++i) {  // around the old shrink threshold
+    b.push_back(i);
+    b.pop_front();
+  }
+  CHECK(b.capacity() == 32 && b.stats().reallocations == reallocations);
+  while (b.size() > 8) {
+    b.pop_front();
+  }
+  CHECK(b.capacity() == 32);
+  b.pop_front();  // 7 < 32 / 4
+  CHECK(b.capacity() == 16);
+  reallocations = b.stats().reallocations;
+  for (int i = 0; i < 100; ++i) {  // around the new shrink threshold
+    b.push_back(i);
+    b.pop_back();
+  }
+  CHECK(b.capacity() == 16 && b.stats().reallocations == reallocations);
+  while (b.size() < 16) {
+    b.push_back(0);
+  }
+  b.push_back(0);  // grows to 32
+  reallocations = b.stats().reallocations;
+  for (int i = 0; i < 100; ++i) {  // around the grow threshold
+    b.pop_back();
+    b.push_back(i);
+  }
+  CHECK(b.capacity() == 32 && b.stats().reallocations == reallocations);
+
+  circular_buffer<int> plain;  // without auto_shrink, popping keeps the storage
+  plain.reserve(64);
+  for (int i = 0; i < 64; ++i) {
+    plain.push_back(i);
+  }
+  plain.pop_front(63);
+  CHECK(plain.capacity() == 64);
+}
+
+// Inserting near either end of a wrapped buffer shifts that side only; the
+// result matches a deque, with and without growth.
+void test_insert_both_ends() {
+  std::vector<std::string> items = {"x", "y", "z"};
+  for (size_t index : {0, 1, 2, 9, 10, 11}) {
+    circular_buffer<std::string> b;
+    std::deque<std::string> model;
+    b.reserve(16);
+    for (int i = 0; i < 12; ++i) {
+      b.push_back(std::to_string(i));
+    }
+    b.pop_front(8);
+    for (int i = 12; i < 20; ++i) {  // 12 elements wrapping in 16 slots
+      b.push_back(std::to_string(i));
+    }
+    for (auto const& v : b) {
+      model.push_back(v);
+    }
+    CHECK(!b.array_two().empty());
+
+    auto it = b.insert(b.begin() + index, items.begin(), items.end());
+    model.insert(model.begin() + index, items.begin(), items.end());
+    CHECK(it - b.begin() == std::ptrdiff_t(index) && *it == "x");
+    CHECK(b.capacity() == 16 && std::equal(b.begin(), b.end(), model.begin(), model.end()));
+
+    it = b.insert(b.begin() + index, std::string("w"));
+    model.insert(model.begin() + index, "w");
+    CHECK(*it == "w" && std::equal(b.begin(), b.end(), model.begin(), model.end()));
+
+    std::vector<std::string> more(5, "g");  // 21 elements: grows
+    b.insert(b.end() - std::ptrdiff_t(std::min<size_t>(index, 2)), more.begin(), more.end());
+    model.insert(model.end() - std::ptrdiff_t(std::min<size_t>(index, 2)), more.begin(), more.end());
+    CHECK(b.capacity() > 16 && std::equal(b.begin(), b.end(), model.begin(), model.end()));
+  }
+
+  // A fixed buffer refuses what does not fit and is left unchanged.
+  circular_buffer<int> f;
+  f.set_fixed_capacity(4);
+  f.push_back(1);
+  f.push_back(2);
+  f.push_back(3);
+  int three[] = {7, 8, 9};
+  bool threw = false;
+  try {
+    f.insert(f.begin() + 1, three, three + 3);
+  } catch (std::length_error const&) {
+    threw = true;
+  }
+  CHECK(threw && f.size() == 3 && f.capacity() == 4 && f[0] == 1 && f[2] == 3);
+  f.insert(f.begin() + 1, three, three + 1);
+  CHECK(f.size() == 4 && f[1] == 7 && f[3] == 3);
+  threw = false;
+  try {
+    f.insert(f.end(), 5);
+  } catch (std::length_error const&) {
+    threw = true;
+  }
+  CHECK(threw && f.size() == 4);
+}
+
+struct allocation_counts {
+  static inline size_t allocations = 0;
+  static inline size_t deallocations = 0;
+};
+
+template <typename T>
+struct counting_allocator {
+  using value_type = T;
+
+  counting_allocator() = default;
+  template <typename U>
+  counting_allocator(counting_allocator<U> const&) noexcept {}
+
+  T* allocate(size_t n) {
+    ++allocation_counts::allocations;
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* p, size_t n) noexcept {
+    ++allocation_counts::deallocations;
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  friend bool operator==(counting_allocator const&, counting_allocator const&) = default;
+};
+
+template <typename Buffer>
+std::vector<std::string> strings(Buffer const& b) {
+  return std::vector<std::string>(b.begin(), b.end());
+}
+
+// Up to InlineCapacity elements live in the object without allocating;
+// past that the buffer spills to the heap once, and moves and swaps work
+// between inline and heap buffers.
+void test_inline_storage() {
+  using buffer = circular_buffer<std::string, counting_allocator<std::string>, false, 4>;
+  {
+    buffer a;
+    CHECK(a.capacity() == 4);
+    a.push_back("x");
+    for (int i = 0; i < 3; ++i) {
+      a.push_back(std::to_string(i));
+    }
+    a.pop_front();
+    a.push_back("3");  // wraps inline
+    CHECK(allocation_counts::allocations == 0 && !a.array_two().empty());
+    CHECK(strings(a) == (std::vector<std::string>{"0", "1", "2", "3"}));
+
+    buffer copy(a);
+    buffer inline_moved(std::move(copy));
+    CHECK(allocation_counts::allocations == 0);
+    CHECK(copy.empty() && strings(inline_moved) == strings(a));
+
+    a.push_back("4");  // spills, keeping order across the wrap
+    CHECK(allocation_counts::allocations == 1 && a.capacity() > 4);
+    CHECK(strings(a) == (std::vector<std::string>{"0", "1", "2", "3", "4"}));
+
+    buffer heap_moved(std::move(a));  // steals the heap block
+    CHECK(allocation_counts::allocations == 1 && a.empty() && a.capacity() == 4);
+    CHECK(heap_moved.size() == 5 && heap_moved.back() == "4");
+
+    buffer small;
+    small.push_back("s");
+    small.swap(heap_moved);  // inline <-> heap
+    CHECK(small.size() == 5 && small.front() == "0" && small.capacity() > 4);
+    CHECK(heap_moved.size() == 1 && heap_moved.front() == "s" && heap_moved.capacity() == 4);
+    heap_moved.swap(small);  // and back
+    CHECK(heap_moved.size() == 5 && small.size() == 1 && small.front() == "s");
+    small = std::move(heap_moved);
+    CHECK(small.size() == 5 && heap_moved.empty());
+    heap_moved = std::move(inline_moved);
+    CHECK(strings(heap_moved) == (std::vector<std::string>{"0", "1", "2", "3"}));
+    CHECK(allocation_counts::allocations == 1);
+
+    small.pop_front(2);
+    small.shrink_to_fit();  // back to the inline storage
+    CHECK(small.capacity() == 4 && strings(small) == (std::vector<std::string>{"2", "3", "4"}));
+    CHECK(allocation_counts::deallocations == 1);
+  }
+  CHECK(allocation_counts::allocations == allocation_counts::deallocations);
+}
+
+}  // namespace
+
+int main() {
+  test_power_of_two();
+  test_move_only();
+  test_throwing_move_copies();
+  test_fixed_append_prepend();
+  test_insert_both_ends();
+  test_inline_storage();
+  test_shrink_to_fit();
+  test_auto_shrink();
+  test_stats();
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "magic_circular_buffer.h"
+#include "circular_buffer_algorithm.h"
+#include "check.h"
+
+namespace {
+
+template <typename T>
+bool same(magic_circular_buffer<T> const& b, std::deque<T> const& model) {
+  return b.size() == model.size() && std::equal(b.data(), b.data() + b.size(), model.begin());
+}
+
+// Leaves the head a few elements before the end of the storage and writes
+// across it, with push_back and with one append; data() still reads every
+// element back in order through one pointer.
+void test_write_across_wrap() {
+  magic_circular_buffer<char> b(1);
+  size_t cap = b.capacity();
+  CHECK(cap >= 1 && cap % static_cast<size_t>(::sysconf(_SC_PAGESIZE)) == 0);
+  std::deque<char> model;
+  for (size_t i = 0; i < cap; ++i) {
+    b.push_back(char('a' + i % 26));
+    model.push_back(char('a' + i % 26));
+  }
+  for (size_t i = 0; i < cap - 5; ++i) {
+    b.pop_front();
+    model.pop_front();
+  }
+  for (int i = 0; i < 10; ++i) {  // 5 before the end, 5 after
+    b.push_back(char('0' + i));
+    model.push_back(char('0' + i));
+  }
+  CHECK(b.capacity() == cap && same(b, model));
+
+  std::string text(cap - b.size(), 'x');
+  for (size_t i = 0; i < text.size(); ++i) {
+    text[i] = char('A' + i % 26);
+  }
+  b.append(std::span<char const>(text.data(), text.size()));  // fills to capacity, wrapping
+  model.insert(model.end(), text.begin(), text.end());
+  CHECK(b.size() == cap && b.capacity() == cap && same(b, model));
+  CHECK(std::string(b.begin(), b.end()) == std::string(model.begin(), model.end()));
+  CHECK(b.array_two().empty() && b.array_one().size() == cap);
+  CHECK(cb::find(b, 'A') - b.begin() == std::find(model.begin(), model.end(), 'A') - model.begin());
+
+  b.push_back('!');  // grows while wrapped and unwraps into the new mapping
+  model.push_back('!');
+  CHECK(b.capacity() > cap && same(b, model));
+}
+
+// push_front at the start of the storage moves the head to its last slot.
+void test_push_front_wraps() {
+  magic_circular_buffer<uint64_t> b(1);
+  std::deque<uint64_t> model;
+  for (uint64_t i = 0; i < 8; ++i) {
+    b.push_back(i);
+    model.push_back(i);
+  }
+  for (uint64_t i = 100; i < 110; ++i) {
+    b.push_front(i);
+    model.push_front(i);
+  }
+  CHECK(same(b, model) && b.front() == 109 && b.back() == 7);
+  for (size_t i = 0; i < model.size(); ++i) {
+    CHECK(b[i] == model[i]);
+  }
+  magic_circular_buffer<uint64_t> c(b);  // copies through data(), unwrapped
+  CHECK(same(c, model));
+  c.pop_back();
+  CHECK(b.back() == 7 && c.back() == 6);
+  magic_circular_buffer<uint64_t> d(std::move(c));
+  CHECK(c.empty() && c.capacity() == 0 && d.size() == model.size() - 1);
+  std::vector<uint64_t> reversed(b.rbegin(), b.rend());
+  CHECK(std::equal(reversed.begin(), reversed.end(), model.rbegin(), model.rend()));
+}
+
+}  // namespace
+
+int main() {
+  test_write_across_wrap();
+  test_push_front_wraps();
+}
@@ -0,0 +1,100 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mpmc_circular_buffer.h"
+#include "check.h"
+
+namespace {
+
+void test_single_thread() {
+  mpmc_circular_buffer<std::unique_ptr<int>> q(3);
+  CHECK(q.capacity() == 4);
+  for (int i = 0; i < 4; ++i) {
+    CHECK(q.try_push(std::make_unique<int>(i)));
+  }
+  CHECK(!q.try_push(std::make_unique<int>(9)));
+  CHECK(q.size() == 4);
+  std::unique_ptr<int> x;
+  CHECK(q.try_pop(x) && *x == 0);
+  CHECK(q.try_emplace(new int(4)));
+
+  mpmc_circular_buffer<std::string> s(1);
+  CHECK(s.capacity() == 2);
+  s.push("a");
+  s.emplace(3, 'b');
+  std::string v;
+  s.pop(v);
+  CHECK(v == "a");
+  CHECK(s.pop() == "bbb");
+  s.push(std::string(50, 'c'));
+}
+
+// Every producer pushes 0..per-1 tagged with its id; each consumer must see
+// the values of any one producer in increasing order, and the values seen
+// by all consumers must add up to the values pushed.
+template <bool Blocking>
+void run(int producers, int consumers, size_t capacity, int per) {
+  mpmc_circular_buffer<std::pair<int, int>> q(capacity);
+  int total = producers * per;
+  std::atomic<long> sum{0};
+  std::atomic<int> claimed{0};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (int i = 0; i < per; ++i) {
+        if constexpr (Blocking) {
+          q.push({p, i});
+        } else {
+          while (!q.try_push({p, i})) {
+            std::this_thread::yield();
+          }
+        }
+      }
+    });
+  }
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&] {
+      std::vector<int> last(producers, -1);
+      for (;;) {
+        std::pair<int, int> v;
+        if constexpr (Blocking) {
+          if (claimed.fetch_add(1) >= total) {
+            break;
+          }
+          v = q.pop();
+        } else {
+          if (claimed.load() >= total) {
+            break;
+          }
+          if (!q.try_pop(v)) {
+            std::this_thread::yield();
+            continue;
+          }
+          claimed.fetch_add(1);
+        }
+        CHECK(v.second > last[v.first]);
+        last[v.first] = v.second;
+        sum += v.second;
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  CHECK(sum == long(producers) * per * (per - 1) / 2);
+  CHECK(q.empty());
+}
+
+}  // namespace
+
+int main() {
+  test_single_thread();
+  run<false>(4, 4, 8, 20000);
+  run<true>(4, 4, 4, 20000);
+  run<true>(1, 6, 2, 20000);
+  run<true>(6, 1, 2, 20000);
+}
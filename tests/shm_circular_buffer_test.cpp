@@ -0,0 +1,153 @@
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shm_circular_buffer.h"
+#include "check.h"
+
+namespace {
+
+struct record {
+  uint64_t seq;
+  double price;
+};
+
+constexpr uint64_t count = 200000;
+
+// A forked producer streams records through the file while the parent
+// consumes them with pop_front, try_pop_n and peek/consume in turn.
+void test_cross_process(char const* path) {
+  auto b = shm_circular_buffer<record>::create(path, 100);
+  CHECK(b.capacity() == 128 && b.empty());
+  pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0) {
+    auto p = shm_circular_buffer<record>::open(path);
+    std::vector<record> batch;
+    for (uint64_t i = 0; i < count;) {
+      size_t pushed;
+      if (i % 3 == 0) {
+        pushed = p.try_push_back({i, i * 0.5});
+      } else {
+        batch.clear();
+        for (uint64_t j = i; j < i + 7 && j < count; ++j) {
+          batch.push_back({j, j * 0.5});
+        }
+        pushed = p.try_push_n(batch);
+      }
+      if (pushed == 0) {
+        std::this_thread::yield();
+      }
+      i += pushed;
+    }
+    _exit(0);
+  }
+
+  uint64_t next = 0;
+  record out[16];
+  while (next < count) {
+    uint64_t before = next;
+    switch (next % 3) {
+    case 0:
+      if (!b.empty()) {
+        CHECK(b.front().seq == next);
+        b.pop_front();
+        ++next;
+      }
+      break;
+    case 1:
+      for (size_t i = 0, k = b.try_pop_n(out, 16); i < k; ++i, ++next) {
+        CHECK(out[i].seq == next && out[i].price == next * 0.5);
+      }
+      break;
+    default: {
+      auto [one, two] = b.peek(20);
+      for (record const& r : one) {
+        CHECK(r.seq == next++);
+      }
+      for (record const& r : two) {
+        CHECK(r.seq == next++);
+      }
+      b.consume(one.size() + two.size());
+    }
+    }
+    if (next == before) {
+      std::this_thread::yield();
+    }
+  }
+  int status;
+  CHECK(waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  CHECK(b.empty());
+
+  // Leave 100 records that wrap, for the reopen below.
+  for (uint64_t i = 0; i < 100; ++i) {
+    CHECK(b.try_push_back({i, 1.0}));
+  }
+  b.sync();
+}
+
+void test_reopen(char const* path) {
+  auto b = shm_circular_buffer<record>::open(path);
+  CHECK(b.size() == 100);
+  auto [one, two] = b.peek(b.capacity());
+  CHECK(one.size() + two.size() == 100 && !two.empty());
+  CHECK(one.front().seq == 0 && two.back().seq == 99);
+  auto [first, rest] = b.peek(10);
+  CHECK(first.size() == 10 && rest.empty());
+  for (int i = 0; i < 28; ++i) {
+    CHECK(b.try_push_back({0, 0}));
+  }
+  CHECK(!b.try_push_back({0, 0}));
+  b.consume(10);
+  CHECK(b.size() == 118 && b.front().seq == 10);
+  auto moved = std::move(b);
+  CHECK(moved.size() == 118);
+}
+
+void test_errors(char const* path) {
+  bool threw = false;
+  try {
+    shm_circular_buffer<int>::open(path);  // element size differs
+  } catch (std::runtime_error const&) {
+    threw = true;
+  }
+  CHECK(threw);
+  std::string missing = std::string(path) + ".missing";
+  threw = false;
+  try {
+    shm_circular_buffer<int>::open(missing.c_str());
+  } catch (std::system_error const& e) {
+    threw = e.code().value() == ENOENT;
+  }
+  CHECK(threw);
+}
+
+void test_shm() {
+  std::string name = "/shm_circular_buffer_test." + std::to_string(getpid());
+  auto a = shm_circular_buffer<int>::create_shm(name.c_str(), 4);
+  CHECK(a.try_push_back(42));
+  auto b = shm_circular_buffer<int>::open_shm(name.c_str());
+  shm_circular_buffer<int>::remove_shm(name.c_str());
+  int x;
+  CHECK(b.try_pop_front(x) && x == 42);
+  CHECK(a.empty());
+}
+
+}  // namespace
+
+int main() {
+  std::string path = "shm_circular_buffer_test." + std::to_string(getpid()) + ".bin";
+  test_cross_process(path.c_str());
+  test_reopen(path.c_str());
+  test_errors(path.c_str());
+  unlink(path.c_str());
+  test_shm();
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#include "soa_circular_buffer.h"
+#include "circular_buffer_stats.h"
+#include "check.h"
+
+namespace {
+
+// The array-of-structs layout the columns are checked against.
+struct tick {
+  int64_t ts;
+  double price;
+  int32_t qty;
+  char side;
+};
+
+using ticks = soa_circular_buffer<int64_t, double, int32_t, char>;
+
+tick make_tick(int i) {
+  return {1000 + i, 0.5 * i, i % 7, i % 2 == 0 ? 'b' : 's'};
+}
+
+void push_back(ticks& b, std::deque<tick>& model, int i) {
+  tick t = make_tick(i);
+  b.push_back(t.ts, t.price, t.qty, t.side);
+  model.push_back(t);
+}
+
+void push_front(ticks& b, std::deque<tick>& model, int i) {
+  tick t = make_tick(i);
+  b.push_front(std::tuple(t.ts, t.price, t.qty, t.side));
+  model.push_front(t);
+}
+
+// Column I, read through array_one<I>() then array_two<I>(), holds field
+// I of every record in order, and column<I>() shows the same segments.
+template <size_t I, typename Field>
+void check_column(ticks const& b, std::deque<tick> const& model, Field tick::*field) {
+  auto one = b.array_one<I>();
+  auto two = b.array_two<I>();
+  CHECK(one.size() + two.size() == model.size());
+  CHECK(two.empty() || one.data() + one.size() == two.data() + b.capacity());
+  std::vector<Field> got(one.begin(), one.end());
+  got.insert(got.end(), two.begin(), two.end());
+  for (size_t k = 0; k < model.size(); ++k) {
+    CHECK(got[k] == model[k].*field && b.get<I>(k) == model[k].*field);
+  }
+  auto col = b.column<I>();
+  CHECK(col.size() == model.size() && col.array_one().data() == one.data() &&
+        col.array_two().size() == two.size());
+}
+
+void check_equal(ticks const& b, std::deque<tick> const& model) {
+  CHECK(b.size() == model.size() && b.empty() == model.empty());
+  check_column<0>(b, model, &tick::ts);
+  check_column<1>(b, model, &tick::price);
+  check_column<2>(b, model, &tick::qty);
+  check_column<3>(b, model, &tick::side);
+  for (size_t k = 0; k < model.size(); ++k) {
+    auto [ts, price, qty, side] = b[k];
+    CHECK(ts == model[k].ts && price == model[k].price && qty == model[k].qty && side == model[k].side);
+  }
+}
+
+// Pushes at both ends until the records wrap, then grows while wrapped:
+// the columns move together and stay in order.
+void test_growth_across_wrap() {
+  ticks b;
+  std::deque<tick> model;
+  b.reserve(8);
+  CHECK(b.capacity() == 8);
+  for (int i = 0; i < 5; ++i) {
+    push_back(b, model, i);
+  }
+  for (int i = 5; i < 8; ++i) {
+    push_front(b, model, i);
+  }
+  CHECK(b.capacity() == 8 && !b.array_two<0>().empty());
+  check_equal(b, model);
+  push_front(b, model, 8);  // grows at the front while full and wrapped
+  CHECK(b.capacity() == 16 && std::get<0>(b.front()) == make_tick(8).ts);
+  check_equal(b, model);
+  push_back(b, model, 9);
+  check_equal(b, model);
+
+  unsigned seed = 3;
+  for (int i = 10; i < 3000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    switch ((seed >> 16) % 5) {
+    case 0:
+      push_front(b, model, i);
+      break;
+    case 1:
+    case 2:
+      push_back(b, model, i);
+      break;
+    case 3:
+      if (!model.empty()) {
+        b.pop_front();
+        model.pop_front();
+      }
+      break;
+    default:
+      if (!model.empty()) {
+        b.pop_back();
+        model.pop_back();
+      }
+    }
+    if (i % 101 == 0) {
+      check_equal(b, model);
+    }
+  }
+  check_equal(b, model);
+  double price_sum = 0;
+  for (tick const& t : model) {
+    price_sum += t.price;
+  }
+  CHECK(cb::sum(b.column<1>()) == price_sum);  // halves of integers add exactly
+  b.pop_front(b.size() / 2);
+  model.erase(model.begin(), model.begin() + model.size() / 2);
+  check_equal(b, model);
+  b.clear();
+  model.clear();
+  check_equal(b, model);
+}
+
+// The proxy iterator: random access, reads and writes whole records, and
+// works with std::copy in both directions and with the const iterator.
+void test_iterator() {
+  ticks b;
+  std::deque<tick> model;
+  b.reserve(16);
+  for (int i = 0; i < 12; ++i) {
+    push_back(b, model, i);
+  }
+  for (int i = 0; i < 8; ++i) {  // head in the middle, 4 records wrapped
+    b.pop_front();
+    model.pop_front();
+    push_back(b, model, 12 + i);
+  }
+  CHECK(b.capacity() == 16 && !b.array_two<0>().empty());
+
+  std::vector<std::tuple<int64_t, double, int32_t, char>> out;
+  std::copy(b.begin(), b.end(), std::back_inserter(out));
+  CHECK(out.size() == model.size());
+  for (size_t k = 0; k < model.size(); ++k) {
+    CHECK(std::get<0>(out[k]) == model[k].ts && std::get<3>(out[k]) == model[k].side);
+  }
+
+  ticks::iterator it = b.begin();
+  CHECK(b.end() - it == ptrdiff_t(b.size()) && it + 5 > it && it[5] == b[5]);
+  CHECK(std::get<2>(*(b.end() - 1)) == model.back().qty && std::get<0>(it[11]) == model[11].ts);
+  ticks::const_iterator cit = it;
+  CHECK(cit == static_cast<ticks const&>(b).begin() && std::get<0>(*cit) == model[0].ts);
+  auto at = std::find_if(b.begin(), b.end(), [](auto const& r) { return std::get<0>(r) == 1015; });
+  CHECK(at - b.begin() == 7);
+
+  // Writes through the proxy: reversed into the buffer, over the wrap.
+  std::copy(out.rbegin(), out.rend(), b.begin());
+  std::reverse(model.begin(), model.end());
+  check_equal(b, model);
+  std::get<1>(*it) = -1;  // assigns the price column only
+  model.front().price = -1;
+  check_equal(b, model);
+
+  std::vector<int64_t> backwards;
+  for (auto r = b.rbegin(); r != b.rend(); ++r) {
+    backwards.push_back(std::get<0>(*r));
+  }
+  CHECK(backwards.size() == model.size() && backwards.front() == model.back().ts);
+}
+
+// Copies are unwrapped and independent; moves leave the source empty.
+void test_copy_move() {
+  ticks b;
+  std::deque<tick> model;
+  b.reserve(8);
+  for (int i = 0; i < 6; ++i) {
+    push_back(b, model, i);
+  }
+  b.pop_front(4);
+  model.erase(model.begin(), model.begin() + 4);
+  for (int i = 6; i < 10; ++i) {
+    push_back(b, model, i);
+  }
+  CHECK(!b.array_two<1>().empty());
+
+  ticks c(b);
+  check_equal(c, model);
+  CHECK(c.array_two<1>().empty() && c.capacity() == 8);
+  std::get<2>(c[0]) = 99;
+  CHECK(b.get<2>(0) == model[0].qty);
+
+  ticks d;
+  d = c;
+  CHECK(d.get<2>(0) == 99 && d.size() == c.size());
+  ticks e(std::move(d));
+  CHECK(d.empty() && d.capacity() == 0 && e.get<2>(0) == 99);
+  d = std::move(e);
+  CHECK(e.empty() && d.size() == model.size());
+  d.swap(b);
+  check_equal(d, model);
+  CHECK(b.get<2>(0) == 99);
+
+  ticks empty;
+  ticks empty_copy(empty);
+  CHECK(empty_copy.empty() && empty_copy.capacity() == 0);
+}
+
+}  // namespace
+
+int main() {
+  test_growth_across_wrap();
+  test_iterator();
+  test_copy_move();
+}
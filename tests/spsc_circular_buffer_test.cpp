@@ -0,0 +1,125 @@
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_circular_buffer.h"
+#include "check.h"
+
+namespace {
+
+constexpr uint64_t count = 200000;
+
+// The producer pushes 0..count-1 with push_back, try_push_n and, for
+// trivially copyable elements, prepare/commit in turn; the consumer takes
+// them with pop_front, try_pop_n and peek/consume in turn. Every sequence
+// number must arrive exactly once and in order.
+template <typename T, typename Make, typename Seq>
+void run(size_t capacity, Make make, Seq seq) {
+  spsc_circular_buffer<T> q(capacity);
+  std::thread producer([&] {
+    std::vector<T> batch;
+    for (uint64_t i = 0; i < count;) {
+      size_t pushed = 0;
+      switch (i % 3) {
+      case 0:
+        pushed = q.try_push_back(make(i));
+        break;
+      case 1:
+        batch.clear();
+        for (uint64_t j = i; j < i + 5 && j < count; ++j) {
+          batch.push_back(make(j));
+        }
+        pushed = q.try_push_n(batch.begin(), batch.size());
+        break;
+      default:
+        if constexpr (std::is_trivially_copyable_v<T>) {
+          auto [one, two] = q.prepare(std::min<uint64_t>(7, count - i));
+          for (T& slot : one) {
+            slot = make(i + pushed++);
+          }
+          for (T& slot : two) {
+            slot = make(i + pushed++);
+          }
+          q.commit(pushed);
+        } else if (q.size() < q.capacity()) {
+          // Only the consumer changes size() now, and only downwards, so
+          // the blocking push does not spin.
+          q.push_back(make(i));
+          pushed = 1;
+        }
+      }
+      if (pushed == 0) {
+        std::this_thread::yield();
+      }
+      i += pushed;
+    }
+  });
+
+  uint64_t next = 0;
+  std::vector<T> out(16);
+  while (next < count) {
+    uint64_t before = next;
+    switch (next % 3) {
+    case 0:
+      if (!q.empty()) {
+        CHECK(seq(q.front()) == next);
+        q.pop_front();
+        ++next;
+      }
+      break;
+    case 1: {
+      size_t k = q.try_pop_n(out.begin(), out.size());
+      for (size_t i = 0; i < k; ++i) {
+        CHECK(seq(out[i]) == next++);
+      }
+      break;
+    }
+    default: {
+      auto [one, two] = q.peek(11);
+      for (T const& v : one) {
+        CHECK(seq(v) == next++);
+      }
+      for (T const& v : two) {
+        CHECK(seq(v) == next++);
+      }
+      q.consume(one.size() + two.size());
+    }
+    }
+    if (next == before) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  CHECK(q.empty() && q.size() == 0);
+}
+
+void test_single_thread() {
+  spsc_circular_buffer<std::string> q(3);
+  CHECK(q.capacity() == 4);
+  for (int i = 0; i < 4; ++i) {
+    CHECK(q.try_push_back(std::to_string(i)));
+  }
+  CHECK(!q.try_push_back("x") && q.size() == 4);
+  std::string s;
+  CHECK(q.try_pop_front(s) && s == "0");
+  CHECK(q.try_emplace_back(3, 'y'));
+  auto [one, two] = q.peek(10);
+  CHECK(one.size() == 3 && two.size() == 1 && two[0] == "yyy");
+  q.consume(2);
+  CHECK(q.front() == "3");
+  // The destructor destroys what is left.
+}
+
+}  // namespace
+
+int main() {
+  test_single_thread();
+  auto make_int = [](uint64_t i) { return i; };
+  auto int_seq = [](uint64_t v) { return v; };
+  run<uint64_t>(2, make_int, int_seq);
+  run<uint64_t>(64, make_int, int_seq);
+  auto make_string = [](uint64_t i) { return std::to_string(i); };
+  auto string_seq = [](std::string const& v) { return uint64_t(std::stoull(v)); };
+  run<std::string>(8, make_string, string_seq);
+}
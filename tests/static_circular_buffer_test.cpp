@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "static_circular_buffer.h"
+#include "check.h"
+
+namespace {
+
+// Compile-time checks: the whole interface runs in constant evaluation.
+
+// Filling past N overwrites the oldest, and the contents wrap.
+static_assert([] {
+  static_circular_buffer<int, 4> b;
+  for (int i = 0; i < 7; ++i) {
+    b.push_back(i);
+  }
+  return b.full() && b.size() == 4 && b.front() == 3 && b.back() == 6 &&
+         b.array_one().size() == 1 && b.array_two().size() == 3 &&
+         b.array_one()[0] == 3 && b.array_two()[2] == 6;
+}());
+
+// push_front and pop_back, and reads through the iterators.
+static_assert([] {
+  static_circular_buffer<int, 4> b;
+  b.push_back(1);
+  b.push_back(2);
+  b.push_front(0);
+  b.push_front(-1);
+  b.push_front(-2);  // full: overwrites back()
+  b.pop_back();
+  int sum = 0;
+  for (int v : b) {
+    sum += v;
+  }
+  int expected[] = {-2, -1, 0};
+  return b.size() == 3 && sum == -3 && std::equal(b.begin(), b.end(), expected) &&
+         b.end() - b.begin() == 3 && b.begin()[2] == 0 && *b.rbegin() == 0 &&
+         b[0] == -2;
+}());
+
+// Algorithms over the iterators, copies and swaps.
+static_assert([] {
+  static_circular_buffer<int, 5> a;
+  for (int i = 0; i < 8; ++i) {
+    a.push_back(8 - i);
+  }
+  std::sort(a.begin(), a.end());
+  static_circular_buffer<int, 5> b(a);
+  static_circular_buffer<int, 5> c;
+  c.push_back(42);
+  c.swap(b);
+  return std::is_sorted(c.begin(), c.end()) && c.front() == 1 && c.back() == 5 &&
+         b.size() == 1 && b.front() == 42 &&
+         std::accumulate(a.array_one().begin(), a.array_one().end(), 0) +
+             std::accumulate(a.array_two().begin(), a.array_two().end(), 0) == 15;
+}());
+
+// Non-trivial elements in constant evaluation.
+static_assert([] {
+  static_circular_buffer<std::string, 2> b;
+  b.push_back("a");
+  b.push_back("b");
+  b.push_back("c");
+  static_circular_buffer<std::string, 2> moved(std::move(b));
+  return moved.front() == "b" && moved.back() == "c";
+}());
+
+template <size_t N>
+std::vector<std::string> strings(static_circular_buffer<std::string, N> const& b) {
+  return std::vector<std::string>(b.begin(), b.end());
+}
+
+void test_strings() {
+  using buffer = static_circular_buffer<std::string, 3>;
+  buffer a;
+  a.push_back("1");
+  a.push_back("2");
+  a.push_back("3");
+  a.push_back(std::string(40, '4'));  // overwrites "1"
+  CHECK(strings(a) == (std::vector<std::string>{"2", "3", std::string(40, '4')}));
+  a.emplace_front(2, '0');             // overwrites the long string
+  CHECK(strings(a) == (std::vector<std::string>{"00", "2", "3"}));
+
+  buffer copy(a);
+  CHECK(strings(copy) == strings(a));
+  copy.pop_front();
+  copy.push_back("x");
+  buffer assigned;
+  assigned.push_back("old");
+  assigned = copy;
+  CHECK(strings(assigned) == (std::vector<std::string>{"2", "3", "x"}));
+  CHECK(strings(a) == (std::vector<std::string>{"00", "2", "3"}));
+
+  buffer moved(std::move(copy));
+  CHECK(strings(moved) == (std::vector<std::string>{"2", "3", "x"}));
+  buffer move_assigned;
+  move_assigned = std::move(moved);
+  CHECK(strings(move_assigned) == (std::vector<std::string>{"2", "3", "x"}));
+
+  buffer one;
+  one.push_back("only");
+  one.swap(a);
+  CHECK(strings(one) == (std::vector<std::string>{"00", "2", "3"}));
+  CHECK(strings(a) == (std::vector<std::string>{"only"}));
+  a.clear();
+  CHECK(a.empty() && a.begin() == a.end());
+}
+
+}  // namespace
+
+int main() {
+  test_strings();
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "time_window_buffer.h"
+#include "check.h"
+
+namespace {
+
+using std::chrono::microseconds;
+
+struct fake_clock {
+  using duration = microseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<fake_clock>;
+  static constexpr bool is_steady = true;
+};
+
+fake_clock::time_point at(long us) {
+  return fake_clock::time_point(microseconds(us));
+}
+
+// Random pushes, with repeated times, against a vector that expires by
+// scanning.
+void test_against_model() {
+  std::mt19937 rng(3);
+  time_window_buffer<std::string, fake_clock> w(microseconds(500));
+  std::vector<std::pair<long, std::string>> model;
+  auto expire_model = [&](long cutoff) {
+    model.erase(std::remove_if(model.begin(), model.end(), [&](auto const& e) {
+      return e.first < cutoff;
+    }), model.end());
+  };
+  long now = 1000;
+  for (int i = 0; i < 20000; ++i) {
+    now += rng() % 3 == 0 ? 0 : rng() % 40;
+    w.push_back(at(now), std::to_string(i));
+    model.push_back({now, std::to_string(i)});
+    expire_model(now - 500);
+    CHECK(w.size() == model.size());
+    CHECK(w.front().value == model.front().second && w.back().value == model.back().second);
+
+    if (i % 7 == 0) {
+      long t = now - long(rng() % 600);
+      size_t lower = std::lower_bound(model.begin(), model.end(), t, [](auto const& e, long v) {
+        return e.first < v;
+      }) - model.begin();
+      size_t upper = std::upper_bound(model.begin(), model.end(), t, [](long v, auto const& e) {
+        return v < e.first;
+      }) - model.begin();
+      auto [first, last] = w.equal_range(at(t));
+      CHECK(size_t(w.lower_bound(at(t)) - w.begin()) == lower);
+      CHECK(size_t(first - w.begin()) == lower && size_t(last - w.begin()) == upper);
+      auto [from, to] = w.range(at(t), at(t + 50));
+      for (auto it = from; it != to; ++it) {
+        CHECK(it->time >= at(t) && it->time < at(t + 50));
+      }
+    }
+    if (i % 997 == 0) {
+      w.expire(at(now + 100));
+      expire_model(now - 400);
+      CHECK(w.size() == model.size());
+    }
+  }
+}
+
+// Move-only and counting its moves: emplace_back constructs the value
+// inside the entry instead of moving a temporary into it.
+struct tracked {
+  static inline int moves = 0;
+
+  tracked(int a, std::string b) : x(a), s(std::move(b)) {}
+  tracked(tracked&& other) noexcept : x(other.x), s(std::move(other.s)) {
+    ++moves;
+  }
+  tracked(tracked const&) = delete;
+
+  int x;
+  std::string s;
+};
+
+void test_emplace_in_place() {
+  time_window_buffer<tracked, fake_clock> w(microseconds(10));
+  w.emplace_back(at(0), 1, "one");
+  CHECK(tracked::moves == 0);  // nothing to relocate yet
+  w.emplace_back(at(5), 2, "two");
+  CHECK(w.size() == 2 && w[1].value.x == 2 && w[1].value.s == "two");
+  CHECK(w.emplace_back(at(12), 3, "three").value.x == 3);
+  CHECK(w.size() == 2 && w.front().value.x == 2);
+  CHECK(w.evict_before(at(20)) == 2 && w.empty());
+}
+
+}  // namespace
+
+int main() {
+  test_against_model();
+  test_emplace_in_place();
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <span>
+#include <utility>
+
+#include "circular_buffer.h"
+
+// Events from the last window() of time, oldest first, on top of a
+// circular_buffer of (time, value) entries. Times must be pushed in
+// non-decreasing order, so the logical sequence is sorted by time: expiry
+// finds the cutoff by binary search and drops everything before it with
+// one bulk pop_front, and lower_bound/upper_bound/equal_range/range search
+// each contiguous segment instead of scanning the iterators.
+//
+// The times of stored entries must not be changed through the iterators,
+// which would break that order.
+template <typename T, typename Clock = std::chrono::steady_clock>
+struct time_window_buffer {
+  using time_point = typename Clock::time_point;
+  using duration = typename Clock::duration;
+
+  struct entry {
+    template <typename... Args>
+    explicit entry(time_point t, Args&&... args)
+      : time(t)
+      , value(std::forward<Args>(args)...)
+    {}
+
+    time_point time;
+    T value;
+  };
+
+  using buffer_type = circular_buffer<entry>;
+  using iterator = typename buffer_type::iterator;
+  using const_iterator = typename buffer_type::const_iterator;
+
+  explicit time_window_buffer(duration window) // O(1)
+    : span(window)
+  {
+    assert(window >= duration::zero());
+  }
+
+  duration window() const noexcept {           // O(1)
+    return span;
+  }
+  size_t size() const noexcept {               // O(1)
+    return entries.size();
+  }
+  bool empty() const noexcept {                // O(1)
+    return entries.empty();
+  }
+  void clear() noexcept {                      // O(n), O(1) for trivial T
+    entries.clear();
+  }
+  buffer_type const& buffer() const noexcept { // O(1)
+    return entries;
+  }
+
+  // Appends the event at time t, no earlier than back().time, and expires
+  // what falls out of the window ending at t.
+  void push_back(time_point t, T const& value) { // O(log n) + O(k) expired, strong
+    emplace_back(t, value);
+  }
+  void push_back(time_point t, T&& value) {      // O(log n) + O(k) expired, strong
+    emplace_back(t, std::move(value));
+  }
+  template <typename... Args>
+  entry& emplace_back(time_point t, Args&&... args) { // O(log n) + O(k) expired, strong
+    assert(entries.empty() || entries.back().time <= t);
+    entry& e = entries.emplace_back(t, std::forward<Args>(args)...);
+    expire(t);
+    return e;
+  }
+
+  // Drops the entries older than now - window(). Returns how many.
+  size_t expire(time_point now) noexcept {     // O(log n) + O(k), O(log n) for trivial T
+    return evict_before(now - span);
+  }
+  // Drops the entries older than cutoff. Returns how many.
+  size_t evict_before(time_point cutoff) noexcept { // O(log n) + O(k), O(log n) for trivial T
+    size_t n = lower_index(cutoff);
+    entries.pop_front(n);
+    return n;
+  }
+
+  entry& front() noexcept {                    // O(1)
+    return entries.front();
+  }
+  entry const& front() const noexcept {        // O(1)
+    return entries.front();
+  }
+  entry& back() noexcept {                     // O(1)
+    return entries.back();
+  }
+  entry const& back() const noexcept {         // O(1)
+    return entries.back();
+  }
+  entry& operator[](size_t index) noexcept {             // O(1)
+    return entries[index];
+  }
+  entry const& operator[](size_t index) const noexcept { // O(1)
+    return entries[index];
+  }
+
+  iterator begin() noexcept {                  // O(1)
+    return entries.begin();
+  }
+  const_iterator begin() const noexcept {      // O(1)
+    return entries.begin();
+  }
+  iterator end() noexcept {                    // O(1)
+    return entries.end();
+  }
+  const_iterator end() const noexcept {        // O(1)
+    return entries.end();
+  }
+
+  // The first entry at t or later.
+  iterator lower_bound(time_point t) noexcept {             // O(log n)
+    return begin() + lower_index(t);
+  }
+  const_iterator lower_bound(time_point t) const noexcept { // O(log n)
+    return begin() + lower_index(t);
+  }
+  // The first entry later than t.
+  iterator upper_bound(time_point t) noexcept {             // O(log n)
+    return begin() + upper_index(t);
+  }
+  const_iterator upper_bound(time_point t) const noexcept { // O(log n)
+    return begin() + upper_index(t);
+  }
+  // The entries at exactly t.
+  std::pair<iterator, iterator> equal_range(time_point t) noexcept { // O(log n)
+    return {lower_bound(t), upper_bound(t)};
+  }
+  std::pair<const_iterator, const_iterator> equal_range(time_point t) const noexcept { // O(log n)
+    return {lower_bound(t), upper_bound(t)};
+  }
+  // The entries in [from, to).
+  std::pair<iterator, iterator> range(time_point from, time_point to) noexcept { // O(log n)
+    return {lower_bound(from), lower_bound(to)};
+  }
+  std::pair<const_iterator, const_iterator> range(time_point from, time_point to) const noexcept { // O(log n)
+    return {lower_bound(from), lower_bound(to)};
+  }
+
+private:
+  // Number of leading entries for which before(e) holds, which is a
+  // prefix of the sorted sequence: a binary search in the segment that
+  // holds the boundary.
+  template <typename Pred>
+  size_t partition_index(Pred before) const noexcept {
+    auto one = entries.array_one();
+    if (!one.empty() && !before(one.back())) {
+      return std::partition_point(one.begin(), one.end(), before) - one.begin();
+    }
+    auto two = entries.array_two();
+    return one.size() + (std::partition_point(two.begin(), two.end(), before) - two.begin());
+  }
+
+  size_t lower_index(time_point t) const noexcept {
+    return partition_index([t](entry const& e) {
+      return e.time < t;
+    });
+  }
+  size_t upper_index(time_point t) const noexcept {
+    return partition_index([t](entry const& e) {
+      return e.time <= t;
+    });
+  }
+
+  duration span;
+  buffer_type entries;
+};